@@ -2,7 +2,8 @@
 #include "diopter.h"
 #include "gui/imgui_ext.h"
 
-Diopter::Diopter(Window& window) : window(window), cam(window), renderer(pool) {
+Diopter::Diopter(Window& window, Render::Heaps heaps)
+    : window(window), cam(window), renderer(pool, heaps) {
 }
 
 Diopter::~Diopter() {
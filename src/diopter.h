@@ -12,7 +12,7 @@ using namespace rpp;
 
 struct Diopter {
 
-    explicit Diopter(Window& window);
+    Diopter(Window& window, Render::Heaps heaps);
     ~Diopter();
 
     void loop();
@@ -20,6 +20,8 @@ int main(int, char**) {
 
         info("Setting up rvk...");
 
+        Render::Heaps heaps = Render::Heaps::automatic();
+
         Vec<String_View, rvk::Alloc> extensions;
 
         Region(R) {
@@ -64,13 +66,13 @@ int main(int, char**) {
                     }
                     return surface;
                 },
-            .host_heap = Math::GB(2),
-            .device_heap = Math::MB(8188),
+            .host_heap = heaps.host,
+            .device_heap = heaps.device,
         });
 
         {
             info("Starting diopter...");
-            Diopter diopter(window);
+            Diopter diopter(window, heaps);
             Profile::Time_Point end = Profile::timestamp();
             info("Started up diopter in %ms!", Profile::ms(end - start));
             diopter.loop();
@@ -0,0 +1,179 @@
+
+// rvk owns the Vulkan loader, so the budget query resolves its own entry points through SDL
+// instead of declaring Vulkan prototypes or linking the loader a second time.
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include <SDL2/SDL_vulkan.h>
+
+#include "heaps.h"
+
+namespace Render {
+
+// Left for the swapchain, other processes, and allocations made outside the rvk heaps.
+static constexpr u64 DEVICE_RESERVE = Math::MB(512);
+
+struct Instance_Functions {
+    PFN_vkDestroyInstance destroy_instance = null;
+    PFN_vkEnumeratePhysicalDevices enumerate_physical_devices = null;
+    PFN_vkEnumerateDeviceExtensionProperties enumerate_device_extension_properties = null;
+    PFN_vkGetPhysicalDeviceProperties get_physical_device_properties = null;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 get_physical_device_memory_properties2 = null;
+
+    [[nodiscard]] bool ok() const {
+        return destroy_instance && enumerate_physical_devices &&
+               enumerate_device_extension_properties && get_physical_device_properties &&
+               get_physical_device_memory_properties2;
+    }
+};
+
+static Instance_Functions load_instance_functions(PFN_vkGetInstanceProcAddr get_proc,
+                                                  VkInstance instance) {
+    return Instance_Functions{
+        .destroy_instance =
+            reinterpret_cast<PFN_vkDestroyInstance>(get_proc(instance, "vkDestroyInstance")),
+        .enumerate_physical_devices = reinterpret_cast<PFN_vkEnumeratePhysicalDevices>(
+            get_proc(instance, "vkEnumeratePhysicalDevices")),
+        .enumerate_device_extension_properties =
+            reinterpret_cast<PFN_vkEnumerateDeviceExtensionProperties>(
+                get_proc(instance, "vkEnumerateDeviceExtensionProperties")),
+        .get_physical_device_properties = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties>(
+            get_proc(instance, "vkGetPhysicalDeviceProperties")),
+        .get_physical_device_memory_properties2 =
+            reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(
+                get_proc(instance, "vkGetPhysicalDeviceMemoryProperties2")),
+    };
+}
+
+static bool has_extension(const Instance_Functions& vk, VkPhysicalDevice device,
+                          String_View name) {
+    bool found = false;
+    Region(R) {
+        u32 n_extensions = 0;
+        vk.enumerate_device_extension_properties(device, null, &n_extensions, null);
+        Vec<VkExtensionProperties, Mregion<R>> extensions;
+        extensions.resize(n_extensions);
+        vk.enumerate_device_extension_properties(device, null, &n_extensions, extensions.data());
+        for(auto& extension : extensions) {
+            found |= String_View{extension.extensionName} == name;
+        }
+    }
+    return found;
+}
+
+// Returns the budget of the largest device local heap, or its size if the device can't report
+// a budget.
+static u64 device_local_budget(const Instance_Functions& vk, VkPhysicalDevice device) {
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceMemoryProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+    };
+    bool has_budget = has_extension(vk, device, String_View{VK_EXT_MEMORY_BUDGET_EXTENSION_NAME});
+    if(has_budget) properties.pNext = &budget;
+    vk.get_physical_device_memory_properties2(device, &properties);
+
+    u64 largest = 0;
+    for(u32 i = 0; i < properties.memoryProperties.memoryHeapCount; i++) {
+        const auto& heap = properties.memoryProperties.memoryHeaps[i];
+        if(!(heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) continue;
+        largest = Math::max(largest, has_budget ? budget.heapBudget[i] : heap.size);
+    }
+    return largest;
+}
+
+static bool supports_ray_tracing(const Instance_Functions& vk, VkPhysicalDevice device) {
+    return has_extension(vk, device, String_View{VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME}) &&
+           has_extension(vk, device, String_View{VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME});
+}
+
+// Mirrors the choice rvk::startup makes: the first discrete GPU that supports ray tracing,
+// otherwise the first device that does. Presentation support can't be checked without a
+// surface, so this may differ from rvk when a device can't present to the window.
+static Opt<VkPhysicalDevice> select_device(const Instance_Functions& vk, VkInstance instance) {
+    Opt<VkPhysicalDevice> selected;
+    Region(R) {
+        u32 n_devices = 0;
+        vk.enumerate_physical_devices(instance, &n_devices, null);
+        Vec<VkPhysicalDevice, Mregion<R>> devices;
+        devices.resize(n_devices);
+        vk.enumerate_physical_devices(instance, &n_devices, devices.data());
+        for(auto& device : devices) {
+            if(!supports_ray_tracing(vk, device)) continue;
+
+            VkPhysicalDeviceProperties properties = {};
+            vk.get_physical_device_properties(device, &properties);
+            if(properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+                selected = Opt{device};
+                break;
+            }
+            if(!selected.ok()) selected = Opt{device};
+        }
+    }
+    return selected;
+}
+
+Heaps Heaps::automatic() {
+
+    Heaps heaps;
+
+    auto get_proc =
+        reinterpret_cast<PFN_vkGetInstanceProcAddr>(SDL_Vulkan_GetVkGetInstanceProcAddr());
+    PFN_vkCreateInstance create_instance = null;
+    if(get_proc) {
+        create_instance = reinterpret_cast<PFN_vkCreateInstance>(
+            get_proc(VK_NULL_HANDLE, "vkCreateInstance"));
+    }
+    if(!create_instance) {
+        warn("Failed to load the Vulkan loader, using default heap sizes.");
+        return heaps;
+    }
+
+    VkApplicationInfo app_info = {
+        .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+        .apiVersion = VK_API_VERSION_1_3,
+    };
+    VkInstanceCreateInfo instance_info = {
+        .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+        .pApplicationInfo = &app_info,
+    };
+
+    VkInstance instance = VK_NULL_HANDLE;
+    if(create_instance(&instance_info, null, &instance) != VK_SUCCESS) {
+        warn("Failed to query the device memory budget, using default heap sizes.");
+        return heaps;
+    }
+
+    Instance_Functions vk = load_instance_functions(get_proc, instance);
+    if(!vk.ok()) {
+        if(vk.destroy_instance) vk.destroy_instance(instance, null);
+        warn("Failed to load Vulkan instance functions, using default heap sizes.");
+        return heaps;
+    }
+
+    auto device = select_device(vk, instance);
+    u64 budget = device.ok() ? device_local_budget(vk, *device) : 0;
+
+    vk.destroy_instance(instance, null);
+
+    if(!device.ok()) {
+        warn("Found no device that supports ray tracing, using default heap sizes.");
+        return heaps;
+    }
+
+    if(budget <= 2 * DEVICE_RESERVE) {
+        warn("Device memory budget is too small, using default heap sizes.");
+        return heaps;
+    }
+
+    heaps.device = (budget - DEVICE_RESERVE) / Math::MB(1) * Math::MB(1);
+    heaps.host = Math::min(Math::max(heaps.device / 4, Math::MB(256)), Math::GB(2));
+
+    info("Sized heaps from the device memory budget: % MB device, % MB host.",
+         heaps.device / Math::MB(1), heaps.host / Math::MB(1));
+    return heaps;
+}
+
+} // namespace Render
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <rpp/base.h>
+
+using namespace rpp;
+
+namespace Render {
+
+// Heaps handed to rvk::startup. Scene uploads derive their in-flight budget from these.
+struct Heaps {
+    u64 host = Math::GB(2);
+    u64 device = Math::MB(8188);
+
+    // Sizes the heaps from the memory budget of the device rvk::startup will select. Must be
+    // called after the Vulkan window is created and before rvk::startup; falls back to the
+    // defaults if the budget can't be queried.
+    static Heaps automatic();
+};
+
+} // namespace Render
@@ -43,6 +43,9 @@ Async::Task<rvk::Shader_Loader::Token> Renderer::make_pipeline(Render::Pipeline&
                                                                rvk::Binding_Table& old_table) {
     co_await pool.suspend();
     co_return T::reload(scene.layout(), *shaders, [&](Render::Pipeline&& new_pipeline) {
+        Thread::Lock lock(pipelines_mutex);
+        pipelines_generation++;
+
         rvk::drop([old_pipeline = Box<Render::Pipeline, rvk::Alloc>{move(old_pipeline)}]() {});
         rvk::drop([old_table = Box<rvk::Binding_Table, rvk::Alloc>{move(old_table)}]() {});
 
@@ -62,7 +65,9 @@ static Async::Task<void> reload_pipeline(Async::Pool<>& pool, rvk::Shader_Loader
     shaders.trigger(token);
 }
 
-Renderer::Renderer(Async::Pool<>& pool) : pool(pool), shaders(rvk::make_shader_loader()) {
+Renderer::Renderer(Async::Pool<>& pool, Render::Heaps heaps)
+    : pool(pool), shaders(rvk::make_shader_loader()),
+      scene_config(GPU_Scene::Config::automatic(heaps.host, heaps.device)) {
 
     auto g_task = make_pipeline<Render::Geometry>(geometry, geometry_table);
     auto ao_task = make_pipeline<Render::AO>(ambient_occlusion, ao_table);
@@ -79,11 +84,15 @@ Renderer::Renderer(Async::Pool<>& pool) : pool(pool), shaders(rvk::make_shader_l
         post_process = move(new_pipeline);
     });
 
+    shared_feedback = GPU_Scene::make_shared_feedback();
+    if(shared_feedback) scene_config.shared_feedback = &shared_feedback;
+
     rebuild_frames();
 }
 
 Renderer::~Renderer() {
     if(loading_scene.ok()) static_cast<void>(loading_scene.block());
+    if(preparing_snapshot.ok()) static_cast<void>(preparing_snapshot.block());
 
     rvk::drop([geometry = Box<Render::Pipeline, rvk::Alloc>{move(geometry)}]() {});
     rvk::drop([geometry_table = Box<rvk::Binding_Table, rvk::Alloc>{move(geometry_table)}]() {});
@@ -103,16 +112,22 @@ Renderer::~Renderer() {
 
     rvk::drop([frames = move(frames)]() {});
     rvk::drop([scene = Box<GPU_Scene::Scene, rvk::Alloc>{move(scene)}]() {});
+    rvk::drop([shared_feedback = move(shared_feedback)]() {});
     rvk::drop([shaders = Box<rvk::Shader_Loader, rvk::Alloc>{move(shaders)}]() {});
 }
 
-void Renderer::rebuild_binding_tables() {
+void Renderer::drop_binding_tables() {
     rvk::drop([geometry_table = Box<rvk::Binding_Table, rvk::Alloc>{move(geometry_table)}]() {});
     rvk::drop([ao_table = Box<rvk::Binding_Table, rvk::Alloc>{move(ao_table)}]() {});
     rvk::drop([shading_table = Box<rvk::Binding_Table, rvk::Alloc>{move(shading_table)}]() {});
     rvk::drop([material_path_table =
                    Box<rvk::Binding_Table, rvk::Alloc>{move(material_path_table)}]() {});
+}
 
+void Renderer::rebuild_binding_tables() {
+    drop_binding_tables();
+
+    Thread::Lock lock(pipelines_mutex);
     rvk::sync([&](rvk::Commands& cmds) {
         geometry_table = scene.table(Render::Geometry::table_type, cmds, geometry.pipeline);
         ao_table = scene.table(Render::AO::table_type, cmds, ambient_occlusion.pipeline);
@@ -160,6 +175,20 @@ void Renderer::render(Camera& cam) {
     auto& cmds = frame.frame_cmds;
     cmds.reset();
 
+    // Edits only restart accumulation for the integrators that read what changed.
+    {
+        auto edits = scene.flush_edits(cmds);
+        bool reads_materials =
+            integrator == Integrator::shading || integrator == Integrator::material_path;
+        bool reads_lights = integrator == Integrator::material_path;
+        if((edits.materials && reads_materials) || (edits.lights && reads_lights)) {
+            stationary_frames = 0;
+        }
+    }
+
+    // Streamed images replace lower resolution versions that earlier samples were shaded with.
+    if(scene.stream(pool, cmds)) stationary_frames = 0;
+
     switch(integrator) {
     case Integrator::geometry: {
         using namespace Render;
@@ -352,6 +381,39 @@ void Renderer::gui() {
         needs_reset = true;
     }
 
+    if(scene.material_count() && TreeNode("Material")) {
+        u32 last = static_cast<u32>(scene.material_count() - 1);
+        edited_material = Math::min(edited_material, last);
+        SliderU32("Index", &edited_material, 0, last);
+
+        GPU_Scene::GPU_Material material = scene.material(edited_material);
+        bool changed = false;
+        for(u32 i = 0; i < 12; i++) {
+            PushID(static_cast<i32>(i));
+            u32 texture = material.textures[i].id;
+            if(InputScalar("Texture", ImGuiDataType_U32, &texture)) {
+                material.textures[i].id = texture;
+                changed = true;
+            }
+            changed |= DragFloat4("Spectrum", material.spectra[i].data, 0.01f);
+            PopID();
+        }
+        if(changed) scene.edit_material(edited_material, material);
+        TreePop();
+    }
+    if(scene.light_count() && TreeNode("Light")) {
+        u32 last = static_cast<u32>(scene.light_count() - 1);
+        edited_light = Math::min(edited_light, last);
+        SliderU32("Index", &edited_light, 0, last);
+
+        GPU_Scene::GPU_Delta_Light light = scene.light(edited_light);
+        bool changed = DragFloat3("Power", light.power.data, 0.01f, 0.0f);
+        changed |= DragFloat4("Param 0", light.params[0].data, 0.01f);
+        changed |= DragFloat4("Param 1", light.params[1].data, 0.01f);
+        if(changed) scene.edit_light(edited_light, light);
+        TreePop();
+    }
+
     Unindent();
 }
 
@@ -439,43 +501,88 @@ Async::Task<void> Renderer::save_image() {
                    buffer.map(), 0);
 }
 
-Async::Task<GPU_Scene::Scene> Renderer::load_scene_gltf(String_View path_) {
+Async::Task<Renderer::Prepared_Scene> Renderer::prepare_scene(GPU_Scene::Scene scene_) {
+    co_await pool.suspend();
+
+    Profile::Time_Point started = Profile::timestamp();
+
+    Prepared_Scene ret;
+    ret.scene = move(scene_);
+
+    co_await rvk::async(pool, [&](rvk::Commands& cmds) {
+        Thread::Lock lock(pipelines_mutex);
+        ret.pipelines_generation = pipelines_generation;
+        ret.geometry_table =
+            ret.scene.table(Render::Geometry::table_type, cmds, geometry.pipeline);
+        ret.ao_table = ret.scene.table(Render::AO::table_type, cmds, ambient_occlusion.pipeline);
+        ret.shading_table = ret.scene.table(Render::Shading::table_type, cmds, shading.pipeline);
+        ret.material_path_table =
+            ret.scene.table(Render::MatPath::table_type, cmds, material_path.pipeline);
+    });
+
+    Profile::Time_Point finished = Profile::timestamp();
+    info("Built binding tables in %ms.", Profile::ms(finished - started));
+
+    co_return ret;
+}
+
+const Texture_Cache::Config* Renderer::use_texture_cache(const GPU_Scene::Config& config) {
+    String_View directory{texture_cache_directory.data()};
+    if(directory.length() == 0) return null;
+    texture_cache.directory = directory.string<Texture_Cache::Alloc>();
+    texture_cache.settings = config.texture_cache_settings();
+    return &texture_cache;
+}
+
+Async::Task<Renderer::Prepared_Scene> Renderer::load_scene_gltf(String_View path_) {
     auto path = path_.string<PBRT::Alloc>();
 
+    GPU_Scene::Config config = scene_config;
+    config.texture_cache = use_texture_cache(config);
+
     Profile::Time_Point started_load = Profile::timestamp();
-    auto cpu_scene = co_await GLTF::load(pool, path.view());
+    auto cpu_scene = co_await GLTF::load(pool, path.view(), config.texture_cache);
     Profile::Time_Point finished_load = Profile::timestamp();
     info("Loaded scene from disk in %ms.", Profile::ms(finished_load - started_load));
 
     Profile::Time_Point started_upload = Profile::timestamp();
-    auto gpu_scene = co_await GPU_Scene::load(pool, cpu_scene, max_parallelism);
+    auto gpu_scene = co_await GPU_Scene::load(pool, cpu_scene, config, loading_progress);
     Profile::Time_Point finished_upload = Profile::timestamp();
     info("Uploaded scene to GPU in %ms.", Profile::ms(finished_upload - started_upload));
 
     info("Scene loaded in in %ms.", Profile::ms(finished_upload - started_load));
 
-    co_return gpu_scene;
+    gpu_scene.keep_textures(move(cpu_scene.textures));
+    co_return co_await prepare_scene(move(gpu_scene));
 }
 
-Async::Task<GPU_Scene::Scene> Renderer::load_scene_pbrt(String_View path_) {
+Async::Task<Renderer::Prepared_Scene> Renderer::load_scene_pbrt(String_View path_, bool reload) {
     auto path = path_.string<PBRT::Alloc>();
 
+    // A reload replaces the scene at once rather than building it up again.
+    GPU_Scene::Config config = scene_config;
+    if(reload) config.progressive = false;
+    config.texture_cache = use_texture_cache(config);
+
     Profile::Time_Point started_load = Profile::timestamp();
-    auto cpu_scene = co_await PBRT::load(pool, path.view());
+    auto cpu_scene = co_await PBRT::load(pool, path.view(), config.texture_cache);
     Profile::Time_Point finished_load = Profile::timestamp();
     info("Loaded scene from disk in %ms.", Profile::ms(finished_load - started_load));
 
     Profile::Time_Point started_upload = Profile::timestamp();
-    auto gpu_scene = co_await GPU_Scene::load(pool, cpu_scene, max_parallelism);
+    auto gpu_scene = co_await GPU_Scene::load(pool, cpu_scene, config, loading_progress);
     Profile::Time_Point finished_upload = Profile::timestamp();
     info("Uploaded scene to GPU in %ms.", Profile::ms(finished_upload - started_upload));
 
     info("Scene loaded in in %ms.", Profile::ms(finished_upload - started_load));
 
-    co_return gpu_scene;
+    gpu_scene.keep_textures(move(cpu_scene.textures));
+    auto prepared = co_await prepare_scene(move(gpu_scene));
+    prepared.files = move(cpu_scene.files);
+    co_return prepared;
 }
 
-Async::Task<GPU_Scene::Scene> Renderer::load_scene_open() {
+Async::Task<Renderer::Prepared_Scene> Renderer::load_scene_open() {
     co_await pool.suspend();
 
     char* path = null;
@@ -484,7 +591,7 @@ Async::Task<GPU_Scene::Scene> Renderer::load_scene_open() {
         String_View file{path};
         String_View extension = file.file_extension();
 
-        Async::Task<GPU_Scene::Scene> loading;
+        Async::Task<Prepared_Scene> loading;
 
         if(extension == "pbrt"_v) {
             loading = load_scene_pbrt(file);
@@ -493,7 +600,7 @@ Async::Task<GPU_Scene::Scene> Renderer::load_scene_open() {
         } else {
             warn("Unknown scene file type %.", extension);
             Libc::free(path);
-            co_return {};
+            co_return co_await prepare_scene({});
         }
 
         auto ret = co_await loading;
@@ -501,23 +608,85 @@ Async::Task<GPU_Scene::Scene> Renderer::load_scene_open() {
         co_return ret;
     }
 
-    co_return {};
+    co_return co_await prepare_scene({});
 }
 
-void Renderer::pick_scene(Camera& cam) {
-    if(loading_scene.ok() && loading_scene.done()) {
-        rvk::drop([scene = Box<GPU_Scene::Scene, rvk::Alloc>{move(scene)}]() {});
-        scene = loading_scene.block();
-        cam.set_pos(Vec3{});
-        loading_scene = {};
-        needs_reset = true;
+void Renderer::swap_scene(Prepared_Scene prepared, Camera& cam, bool snapshot) {
+    rvk::drop([scene = Box<GPU_Scene::Scene, rvk::Alloc>{move(scene)}]() {});
+    drop_binding_tables();
+
+    scene = move(prepared.scene);
+    geometry_table = move(prepared.geometry_table);
+    ao_table = move(prepared.ao_table);
+    shading_table = move(prepared.shading_table);
+    material_path_table = move(prepared.material_path_table);
+
+    // A pipeline was reloaded after the tables were built.
+    if(prepared.pipelines_generation != pipelines_generation) {
         rebuild_binding_tables();
     }
 
+    if(!showing_snapshot && !reloading_scene) cam.set_pos(Vec3{});
+    showing_snapshot = snapshot;
+    needs_reset = true;
+
+    if(!snapshot) {
+        reloading_scene = false;
+        scene_files = move(prepared.files);
+        watch_scene_files();
+    }
+}
+
+void Renderer::watch_scene_files() {
+    scene_watcher.clear();
+    if(!watch_scene) return;
+    for(auto& file : scene_files) {
+        scene_watcher.watch(file.view());
+    }
+}
+
+void Renderer::pick_scene(Camera& cam) {
+    // Loads and snapshots build their binding tables on the pool, so here they are only swapped.
+    if(preparing_snapshot.ok() && preparing_snapshot.done()) {
+        auto prepared = preparing_snapshot.block();
+        preparing_snapshot = {};
+        // Drop the snapshot if the finished scene is already waiting.
+        if(!(loading_scene.ok() && loading_scene.done())) {
+            swap_scene(move(prepared), cam, true);
+        } else {
+            rvk::drop([prepared = Box<Prepared_Scene, rvk::Alloc>{move(prepared)}]() {});
+        }
+    }
+    if(!preparing_snapshot.ok()) {
+        if(loading_scene.ok() && loading_scene.done()) {
+            // The finished scene supersedes any snapshot that has not been shown yet.
+            static_cast<void>(loading_progress.take());
+            swap_scene(loading_scene.block(), cam, false);
+            loading_scene = {};
+        } else if(auto snapshot = loading_progress.take(); snapshot.ok()) {
+            preparing_snapshot = prepare_scene(move(*snapshot));
+        }
+    }
+
     using namespace ImGui;
     Indent();
 
-    if(Button("Open")) {
+    // Snapshots borrow from the scene being loaded, so it must finish before another starts.
+    bool idle = !loading_scene.ok() && !preparing_snapshot.ok();
+
+    // Changes made while loading stay queued until the load finishes. The first file recorded
+    // is the scene file itself.
+    if(idle && watch_scene && !scene_watcher.empty()) {
+        auto changed = scene_watcher.poll();
+        if(changed.length()) {
+            for(auto& file : changed) info("Reloading scene, % changed.", file);
+            reloading_scene = true;
+            loading_scene = load_scene_pbrt(scene_files[0].view(), true);
+            idle = false;
+        }
+    }
+
+    if(Button("Open") && idle) {
         loading_scene = load_scene_open();
     }
     SameLine();
@@ -526,15 +695,33 @@ void Renderer::pick_scene(Camera& cam) {
         scene = {};
         needs_reset = true;
         rebuild_binding_tables();
+        scene_files.clear();
+        watch_scene_files();
     }
     SameLine();
-    PushItemWidth(ImGui::GetWindowWidth() * 0.3f);
-    SliderInt("Parallelism", &max_parallelism, 1, 16);
-    PopItemWidth();
+    Text("Upload budget: %u MB staging, %u MB device, %u tasks",
+         static_cast<u32>(scene_config.staging_budget / Math::MB(1)),
+         static_cast<u32>(scene_config.device_budget / Math::MB(1)),
+         static_cast<u32>(scene_config.max_uploads));
+    Checkbox("Bake Objects", &scene_config.bake_objects);
+    SameLine();
+    Checkbox("Compress Textures", &scene_config.compress_textures);
+    SameLine();
+    Combo("HDR Format", scene_config.hdr_format);
+    SameLine();
+    Checkbox("Stream Textures", &scene_config.stream_textures);
+    SameLine();
+    InputText("Texture Cache", texture_cache_directory.data(), texture_cache_directory.length());
+    SameLine();
+    Checkbox("Progressive", &scene_config.progressive);
+    SameLine();
+    if(Checkbox("Watch", &watch_scene)) {
+        watch_scene_files();
+    }
 
 #ifndef RPP_RELEASE_BUILD
 #define LOAD(name, folder, speed)                                                                  \
-    if(Button(name)) {                                                                             \
+    if(Button(name) && idle) {                                                                     \
         loading_scene = load_scene_pbrt(String_View{"pbrt-scenes/" folder});                       \
         cam.set_speed(speed);                                                                      \
     }
@@ -7,11 +7,13 @@
 
 #include "../scene/gpu_scene.h"
 #include "../util/camera.h"
+#include "../util/watch.h"
 
 #include "pipeline.h"
 
 #include "ao.h"
 #include "geometry.h"
+#include "heaps.h"
 #include "matpath.h"
 #include "post.h"
 #include "shading.h"
@@ -28,7 +30,7 @@ constexpr Literal IMAGE_OUTPUT_FILE_TYPES = "png";
 
 struct Renderer {
 
-    Renderer(Async::Pool<>& pool);
+    Renderer(Async::Pool<>& pool, Render::Heaps heaps);
     ~Renderer();
 
     void render(Camera& cam);
@@ -59,22 +61,49 @@ private:
     rvk::Shader_Loader::Token geometry_token, ao_token, shading_token, material_path_token;
     rvk::Binding_Table geometry_table, ao_table, shading_table, material_path_table;
 
+    // Scenes build their binding tables on the pool while hot reloads may replace pipelines.
+    Thread::Mutex pipelines_mutex;
+    u64 pipelines_generation = 0;
+
     Render::Pipeline post_process;
     rvk::Shader_Loader::Token post_token;
 
     void rebuild_frames();
     void rebuild_pipelines();
     void rebuild_binding_tables();
+    void drop_binding_tables();
     template<typename T>
     Async::Task<rvk::Shader_Loader::Token> make_pipeline(Render::Pipeline& old_pipeline,
                                                          rvk::Binding_Table& old_table);
 
     // Scene data
 
+    // A scene along with the binding tables of every integrator, ready to be swapped in.
+    struct Prepared_Scene {
+        GPU_Scene::Scene scene;
+        rvk::Binding_Table geometry_table, ao_table, shading_table, material_path_table;
+        u64 pipelines_generation = 0;
+        Vec<String<PBRT::Alloc>, PBRT::Alloc> files;
+    };
+
     GPU_Scene::Scene scene;
-    Async::Task<GPU_Scene::Scene> loading_scene;
+    Async::Task<Prepared_Scene> loading_scene;
+    Async::Task<Prepared_Scene> preparing_snapshot;
+    GPU_Scene::Progress loading_progress;
+    rvk::Buffer shared_feedback;
+    bool showing_snapshot = false;
+
+    // PBRT scenes reload when the files they were loaded from change.
+    bool watch_scene = false;
+    bool reloading_scene = false;
+    File_Watcher scene_watcher;
+    Vec<String<PBRT::Alloc>, PBRT::Alloc> scene_files;
     Async::Task<void> saving_image;
-    i32 max_parallelism = 32;
+    GPU_Scene::Config scene_config;
+
+    // Encoded textures are kept in this directory across loads when it is set.
+    Array<char, 256> texture_cache_directory;
+    Texture_Cache::Config texture_cache;
 
     // Render settings
 
@@ -100,9 +129,16 @@ private:
     bool hdr = false;
     bool roulette = true;
 
-    Async::Task<GPU_Scene::Scene> load_scene_pbrt(String_View path_);
-    Async::Task<GPU_Scene::Scene> load_scene_gltf(String_View path_);
-    Async::Task<GPU_Scene::Scene> load_scene_open();
+    u32 edited_material = 0;
+    u32 edited_light = 0;
+
+    Async::Task<Prepared_Scene> load_scene_pbrt(String_View path_, bool reload = false);
+    Async::Task<Prepared_Scene> load_scene_gltf(String_View path_);
+    const Texture_Cache::Config* use_texture_cache(const GPU_Scene::Config& config);
+    Async::Task<Prepared_Scene> load_scene_open();
+    Async::Task<Prepared_Scene> prepare_scene(GPU_Scene::Scene scene_);
+    void swap_scene(Prepared_Scene prepared, Camera& cam, bool snapshot);
+    void watch_scene_files();
     Async::Task<void> save_image();
 
     Render::Post::Op postprocess_op(bool output_srgb);
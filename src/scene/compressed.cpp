@@ -0,0 +1,379 @@
+
+#include "compressed.h"
+
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+
+namespace Compressed {
+
+static constexpr u8 KTX2_IDENTIFIER[12] = {0xAB, 'K',  'T',  'X',  ' ',  '2',
+                                           '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+static constexpr u8 DDS_MAGIC[4] = {'D', 'D', 'S', ' '};
+
+static constexpr u64 KTX2_HEADER_SIZE = 80;
+static constexpr u64 KTX2_LEVEL_SIZE = 24;
+static constexpr u32 KTX2_SUPERCOMPRESSION_NONE = 0;
+static constexpr u32 KTX2_SUPERCOMPRESSION_ZSTD = 2;
+
+// Larger images are rejected rather than trusting a corrupt header's allocation size.
+static constexpr u32 MAX_EXTENT = 1 << 15;
+static constexpr u32 MAX_LEVELS = 16;
+
+static constexpr u64 DDS_HEADER_SIZE = 128;
+static constexpr u64 DDS_DX10_HEADER_SIZE = 20;
+static constexpr u32 DDS_FLAG_MIPMAPCOUNT = 0x20000;
+static constexpr u32 DDS_PF_FOURCC = 0x4;
+static constexpr u32 DDS_CAPS2_CUBEMAP = 0x200;
+static constexpr u32 DDS_DIMENSION_TEXTURE2D = 3;
+
+template<typename T>
+static T read(Slice<const u8> file, u64 offset) {
+    T value;
+    Libc::memcpy(&value, file.data() + offset, sizeof(T));
+    return value;
+}
+
+static constexpr u32 fourcc(const char (&code)[5]) {
+    return static_cast<u32>(code[0]) | static_cast<u32>(code[1]) << 8 |
+           static_cast<u32>(code[2]) << 16 | static_cast<u32>(code[3]) << 24;
+}
+
+static bool starts_with(Slice<const u8> file, const u8* prefix, u64 length) {
+    if(file.length() < length) return false;
+    for(u64 i = 0; i < length; i++) {
+        if(file[i] != prefix[i]) return false;
+    }
+    return true;
+}
+
+static bool is_block_compressed(Format format) {
+    return format <= Format::bc7;
+}
+
+// Bytes per 4x4 block of the block compressed formats, or per texel of the others.
+static u64 block_bytes(Format format) {
+    switch(format) {
+    case Format::bc1:
+    case Format::bc1a:
+    case Format::bc4: return 8;
+    case Format::bc2:
+    case Format::bc3:
+    case Format::bc5:
+    case Format::bc6h:
+    case Format::bc7: return 16;
+    case Format::r8: return 1;
+    case Format::r16f: return 2;
+    case Format::rgba8:
+    case Format::b10g11r11f:
+    case Format::e5b9g9r9f:
+    case Format::r32f: return 4;
+    case Format::rgba16f: return 8;
+    case Format::rgba32f: return 16;
+    }
+    RPP_UNREACHABLE;
+}
+
+// KTX2 typeSize: the size of the data type each texel is made of, or 1 for block formats.
+static u32 type_size(Format format) {
+    switch(format) {
+    case Format::r16f:
+    case Format::rgba16f: return 2;
+    case Format::b10g11r11f:
+    case Format::e5b9g9r9f:
+    case Format::r32f:
+    case Format::rgba32f: return 4;
+    default: return 1;
+    }
+}
+
+static u64 level_size(Format format, u32 w, u32 h, u32 level) {
+    u64 level_w = Math::max(level < 32 ? w >> level : 0u, 1u);
+    u64 level_h = Math::max(level < 32 ? h >> level : 0u, 1u);
+    if(!is_block_compressed(format)) return level_w * level_h * block_bytes(format);
+    return ((level_w + 3) / 4) * ((level_h + 3) / 4) * block_bytes(format);
+}
+
+struct Format_Code {
+    u32 code;
+    Format format;
+    bool srgb;
+};
+
+// VkFormat values of the supported formats.
+static constexpr Format_Code KTX2_FORMATS[] = {
+    {131, Format::bc1, false},  {132, Format::bc1, true},        {133, Format::bc1a, false},
+    {134, Format::bc1a, true},  {135, Format::bc2, false},       {136, Format::bc2, true},
+    {137, Format::bc3, false},  {138, Format::bc3, true},        {139, Format::bc4, false},
+    {141, Format::bc5, false},  {143, Format::bc6h, false},      {145, Format::bc7, false},
+    {146, Format::bc7, true},   {9, Format::r8, false},          {15, Format::r8, true},
+    {37, Format::rgba8, false}, {43, Format::rgba8, true},       {76, Format::r16f, false},
+    {97, Format::rgba16f, false}, {122, Format::b10g11r11f, false}, {123, Format::e5b9g9r9f, false},
+    {100, Format::r32f, false}, {109, Format::rgba32f, false},
+};
+
+// DXGI_FORMAT values of the BC formats.
+static constexpr Format_Code DXGI_FORMATS[] = {
+    {71, Format::bc1a, false}, {72, Format::bc1a, true}, {74, Format::bc2, false},
+    {75, Format::bc2, true},   {77, Format::bc3, false}, {78, Format::bc3, true},
+    {80, Format::bc4, false},  {83, Format::bc5, false}, {95, Format::bc6h, false},
+    {98, Format::bc7, false},  {99, Format::bc7, true},
+};
+
+template<u64 N>
+static bool find_format(const Format_Code (&codes)[N], u32 code, Image& image) {
+    for(const auto& entry : codes) {
+        if(entry.code == code) {
+            image.format = entry.format;
+            image.srgb = entry.srgb;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Offsets of each level of a full or partial mip chain, stored contiguously largest first.
+static u64 layout_levels(Image& image, u32 levels) {
+    u64 total = 0;
+    image.offsets.push(0);
+    for(u32 i = 0; i < levels; i++) {
+        total += level_size(image.format, image.w, image.h, i);
+        image.offsets.push(total);
+    }
+    return total;
+}
+
+// With in_place set, levels without supercompression point into the file instead of being copied.
+static Opt<Image> load_ktx2(String_View filename, Slice<const u8> file, bool in_place) {
+
+    if(file.length() < KTX2_HEADER_SIZE) {
+        warn("[KTX2] invalid file %.", filename);
+        return {};
+    }
+
+    u32 vk_format = read<u32>(file, 12);
+    u32 w = read<u32>(file, 20);
+    u32 h = read<u32>(file, 24);
+    u32 depth = read<u32>(file, 28);
+    u32 layers = read<u32>(file, 32);
+    u32 faces = read<u32>(file, 36);
+    u32 levels = Math::min(Math::max(read<u32>(file, 40), 1u), MAX_LEVELS);
+    u32 supercompression = read<u32>(file, 44);
+
+    Image image;
+    image.w = w;
+    image.h = h;
+
+    if(!find_format(KTX2_FORMATS, vk_format, image)) {
+        warn("[KTX2] % has unsupported format %.", filename, vk_format);
+        return {};
+    }
+    if(w == 0 || h == 0 || w > MAX_EXTENT || h > MAX_EXTENT || depth > 1 || layers > 1 ||
+       faces != 1) {
+        warn("[KTX2] % is not a 2D texture.", filename);
+        return {};
+    }
+    if(supercompression != KTX2_SUPERCOMPRESSION_NONE &&
+       supercompression != KTX2_SUPERCOMPRESSION_ZSTD) {
+        warn("[KTX2] % has unsupported supercompression %.", filename, supercompression);
+        return {};
+    }
+#ifndef HAS_ZSTD
+    if(supercompression == KTX2_SUPERCOMPRESSION_ZSTD) {
+        warn("[KTX2] % is zstd supercompressed, but zstd support is not built in.", filename);
+        return {};
+    }
+#endif
+    if(file.length() < KTX2_HEADER_SIZE + levels * KTX2_LEVEL_SIZE) {
+        warn("[KTX2] invalid file %.", filename);
+        return {};
+    }
+
+    in_place = in_place && supercompression == KTX2_SUPERCOMPRESSION_NONE;
+
+    // The level index lists the largest level first, wherever the data is in the file.
+    if(!in_place) image.data.resize(layout_levels(image, levels));
+
+    for(u32 i = 0; i < levels; i++) {
+        u64 index = KTX2_HEADER_SIZE + i * KTX2_LEVEL_SIZE;
+        u64 offset = read<u64>(file, index);
+        u64 length = read<u64>(file, index + 8);
+        u64 expected = level_size(image.format, w, h, i);
+
+        if(offset > file.length() || length > file.length() - offset) {
+            warn("[KTX2] invalid file %.", filename);
+            return {};
+        }
+
+        if(supercompression == KTX2_SUPERCOMPRESSION_ZSTD) {
+#ifdef HAS_ZSTD
+            u8* dst = image.data.data() + image.offsets[i];
+            u64 decoded = ZSTD_decompress(dst, expected, file.data() + offset, length);
+            if(ZSTD_isError(decoded) || decoded != expected) {
+                warn("[KTX2] failed to decompress % level %.", filename, i);
+                return {};
+            }
+#endif
+        } else if(length != expected) {
+            warn("[KTX2] % level % has % bytes, expected %.", filename, i, length, expected);
+            return {};
+        } else if(in_place) {
+            image.mapped.push(Slice<const u8>{file.data() + offset, length});
+        } else {
+            Libc::memcpy(image.data.data() + image.offsets[i], file.data() + offset, length);
+        }
+    }
+
+    return Opt{move(image)};
+}
+
+static Opt<Image> load_dds(String_View filename, Slice<const u8> file) {
+
+    if(file.length() < DDS_HEADER_SIZE) {
+        warn("[DDS] invalid file %.", filename);
+        return {};
+    }
+
+    u32 flags = read<u32>(file, 8);
+    u32 h = read<u32>(file, 12);
+    u32 w = read<u32>(file, 16);
+    u32 levels = flags & DDS_FLAG_MIPMAPCOUNT ? Math::max(read<u32>(file, 28), 1u) : 1u;
+    levels = Math::min(levels, MAX_LEVELS);
+    u32 pf_flags = read<u32>(file, 80);
+    u32 code = read<u32>(file, 84);
+    u32 caps2 = read<u32>(file, 112);
+
+    Image image;
+    image.w = w;
+    image.h = h;
+
+    if(!(pf_flags & DDS_PF_FOURCC)) {
+        warn("[DDS] % is not block compressed.", filename);
+        return {};
+    }
+    if(w == 0 || h == 0 || w > MAX_EXTENT || h > MAX_EXTENT || caps2 & DDS_CAPS2_CUBEMAP) {
+        warn("[DDS] % is not a 2D texture.", filename);
+        return {};
+    }
+
+    u64 data_offset = DDS_HEADER_SIZE;
+    bool known = true;
+    if(code == fourcc("DX10")) {
+        if(file.length() < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE) {
+            warn("[DDS] invalid file %.", filename);
+            return {};
+        }
+        u32 dxgi = read<u32>(file, DDS_HEADER_SIZE);
+        u32 dimension = read<u32>(file, DDS_HEADER_SIZE + 4);
+        u32 array_size = read<u32>(file, DDS_HEADER_SIZE + 12);
+        if(dimension != DDS_DIMENSION_TEXTURE2D || array_size > 1) {
+            warn("[DDS] % is not a 2D texture.", filename);
+            return {};
+        }
+        known = find_format(DXGI_FORMATS, dxgi, image);
+        data_offset += DDS_DX10_HEADER_SIZE;
+    } else if(code == fourcc("DXT1")) {
+        image.format = Format::bc1a;
+    } else if(code == fourcc("DXT2") || code == fourcc("DXT3")) {
+        image.format = Format::bc2;
+    } else if(code == fourcc("DXT4") || code == fourcc("DXT5")) {
+        image.format = Format::bc3;
+    } else if(code == fourcc("ATI1") || code == fourcc("BC4U")) {
+        image.format = Format::bc4;
+    } else if(code == fourcc("ATI2") || code == fourcc("BC5U")) {
+        image.format = Format::bc5;
+    } else {
+        known = false;
+    }
+    if(!known) {
+        warn("[DDS] % has an unsupported format; only BC1-7 are loaded.", filename);
+        return {};
+    }
+    image.srgb_known = code == fourcc("DX10");
+
+    u64 total = layout_levels(image, levels);
+    if(file.length() - data_offset < total) {
+        warn("[DDS] % is truncated.", filename);
+        return {};
+    }
+
+    image.data.resize(total);
+    Libc::memcpy(image.data.data(), file.data() + data_offset, total);
+
+    return Opt{move(image)};
+}
+
+// Levels are written smallest first, as the KTX2 specification recommends for streaming, at
+// offsets aligned to 16 bytes, which suits every format's block or texel size. The file has no
+// data format descriptor, which this loader does not read.
+Vec<u8, Alloc> save_ktx2(const Image& image) {
+
+    u32 levels = image.levels();
+    u32 vk_format = 0;
+    for(const auto& entry : KTX2_FORMATS) {
+        if(entry.format != image.format) continue;
+        if(vk_format == 0 || entry.srgb == image.srgb) vk_format = entry.code;
+    }
+
+    u64 header_size = KTX2_HEADER_SIZE + levels * KTX2_LEVEL_SIZE;
+    Vec<u64, Alloc> offsets;
+    offsets.resize(levels);
+    u64 end = header_size;
+    for(u32 i = levels; i > 0; i--) {
+        end = (end + 15) / 16 * 16;
+        offsets[i - 1] = end;
+        end += image.level(i - 1).length();
+    }
+
+    Vec<u8, Alloc> file;
+    file.resize(end);
+    for(u8& byte : file) byte = 0;
+
+    auto write = [&](u64 offset, auto value) {
+        Libc::memcpy(file.data() + offset, &value, sizeof(value));
+    };
+    Libc::memcpy(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    write(12, vk_format);
+    write(16, type_size(image.format));
+    write(20, image.w);
+    write(24, image.h);
+    write(36, 1u);
+    write(40, levels);
+    write(44, KTX2_SUPERCOMPRESSION_NONE);
+
+    for(u32 i = 0; i < levels; i++) {
+        auto level = image.level(i);
+        u64 index = KTX2_HEADER_SIZE + i * KTX2_LEVEL_SIZE;
+        write(index, offsets[i]);
+        write(index + 8, level.length());
+        write(index + 16, level.length());
+        Libc::memcpy(file.data() + offsets[i], level.data(), level.length());
+    }
+    return file;
+}
+
+bool is_container(Slice<const u8> file) {
+    return starts_with(file, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) ||
+           starts_with(file, DDS_MAGIC, sizeof(DDS_MAGIC));
+}
+
+Opt<Image> load(String_View filename, Slice<const u8> file) {
+    if(starts_with(file, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER))) {
+        return load_ktx2(filename, file, false);
+    }
+    if(starts_with(file, DDS_MAGIC, sizeof(DDS_MAGIC))) {
+        return load_dds(filename, file);
+    }
+    return {};
+}
+
+Opt<Image> load(String_View filename, Mapped_File file) {
+    if(!starts_with(file.slice(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER))) {
+        return load(filename, file.slice());
+    }
+    auto image = load_ktx2(filename, file.slice(), true);
+    if(image.ok() && !image->mapped.empty()) image->file = move(file);
+    return image;
+}
+
+} // namespace Compressed
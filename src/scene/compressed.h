@@ -0,0 +1,95 @@
+
+#pragma once
+
+#include <rpp/base.h>
+
+#include "../util/mapped_file.h"
+
+using namespace rpp;
+
+namespace Compressed {
+
+using Alloc = Mallocator<"Compressed Image">;
+
+// Block compressed formats come first, followed by formats stored per texel.
+enum class Format : u8 {
+    bc1,
+    bc1a,
+    bc2,
+    bc3,
+    bc4,
+    bc5,
+    bc6h,
+    bc7,
+    r8,
+    rgba8,
+    r16f,
+    rgba16f,
+    b10g11r11f,
+    e5b9g9r9f,
+    r32f,
+    rgba32f,
+};
+
+// An image in its device format, read from a KTX2 or DDS file. Levels are stored largest first,
+// each as rows of 4x4 blocks or of texels, and uploaded without decoding.
+struct Image {
+    Vec<u8, Alloc> data;
+    // Offsets of each level in data, followed by the end of the last level.
+    Vec<u64, Alloc> offsets;
+    // Images loaded in place keep their file instead of data, and its levels instead of offsets.
+    Mapped_File file;
+    Vec<Slice<const u8>, Alloc> mapped;
+    u32 w = 0;
+    u32 h = 0;
+    Format format = Format::bc1;
+    bool srgb = false;
+    // Legacy DDS formats do not say whether they are sRGB, so the texture's own encoding applies.
+    bool srgb_known = true;
+
+    [[nodiscard]] u32 levels() const {
+        if(!file.empty()) return static_cast<u32>(mapped.length());
+        return offsets.empty() ? 0 : static_cast<u32>(offsets.length() - 1);
+    }
+    [[nodiscard]] Slice<const u8> level(u32 i) const {
+        if(!file.empty()) return mapped[i];
+        return Slice<const u8>{data.data() + offsets[i], offsets[i + 1] - offsets[i]};
+    }
+
+    // Copies the levels, so the clone does not keep the file.
+    Image clone() const {
+        Image ret;
+        ret.w = w;
+        ret.h = h;
+        ret.format = format;
+        ret.srgb = srgb;
+        ret.srgb_known = srgb_known;
+        u64 total = 0;
+        for(u32 i = 0; i < levels(); i++) {
+            ret.offsets.push(total);
+            total += level(i).length();
+        }
+        ret.offsets.push(total);
+        ret.data.resize(total);
+        for(u32 i = 0; i < levels(); i++) {
+            Libc::memcpy(ret.data.data() + ret.offsets[i], level(i).data(), level(i).length());
+        }
+        return ret;
+    }
+};
+
+// Whether the file starts with a KTX2 or DDS identifier.
+[[nodiscard]] bool is_container(Slice<const u8> file);
+
+// Reads a 2D texture. KTX2 files may hold any of the formats above, and may be zstd
+// supercompressed when built with zstd support; DDS files are loaded only for BC1-7.
+[[nodiscard]] Opt<Image> load(String_View filename, Slice<const u8> file);
+
+// Like load, but KTX2 files without supercompression are read in place: the image keeps the file
+// and its levels point into it. Other files are copied as by load.
+[[nodiscard]] Opt<Image> load(String_View filename, Mapped_File file);
+
+// Writes an image as a KTX2 file without supercompression.
+[[nodiscard]] Vec<u8, Alloc> save_ktx2(const Image& image);
+
+} // namespace Compressed
@@ -19,6 +19,9 @@ static __m256i GATHER3X = _mm256_set_epi32(0, 3, 6, 9, 12, 15, 18, 21);
 static __m256i GATHER3Y = _mm256_set_epi32(1, 4, 7, 10, 13, 16, 19, 22);
 static __m256i GATHER3Z = _mm256_set_epi32(2, 5, 8, 11, 14, 17, 20, 23);
 
+// Source texels summed per vertical pass of the halving filters.
+static constexpr u32 HALVE_CHUNK = 64;
+
 static __m256 LOOP_MASKS[] = {
     _mm256_set_ps(-0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f),
     _mm256_set_ps(-0.0f, -0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f),
@@ -201,6 +204,364 @@ RPP_FORCE_INLINE static __m256 loop_mask(u64 i, u64 n) {
     return LOOP_MASKS[active];
 }
 
+// Gathers a 4x4 block of RGBA texels at (x, y), clamping reads to the edges of the image.
+static void load_block(u8* block, Slice<const u8> in, u32 w, u32 h, u32 channels, u32 x, u32 y) {
+
+    if(channels == 4 && x + 4 <= w && y + 4 <= h) {
+        for(u32 j = 0; j < 4; j++) {
+            Libc::memcpy(block + j * 16, in.data() + (static_cast<u64>(y + j) * w + x) * 4, 16);
+        }
+        return;
+    }
+
+    for(u32 j = 0; j < 4; j++) {
+        u64 row = static_cast<u64>(Math::min(y + j, h - 1)) * w;
+        for(u32 i = 0; i < 4; i++) {
+            const u8* src = in.data() + (row + Math::min(x + i, w - 1)) * channels;
+            u8* dst = block + (j * 4 + i) * 4;
+            dst[0] = src[0];
+            dst[1] = channels > 1 ? src[1] : 0;
+            dst[2] = channels > 2 ? src[2] : 0;
+            dst[3] = channels > 3 ? src[3] : 255;
+        }
+    }
+}
+
+static u32 min_texel(__m256i a, __m256i b) {
+    __m256i m = _mm256_min_epu8(a, b);
+    __m128i r = _mm_min_epu8(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+    r = _mm_min_epu8(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2)));
+    r = _mm_min_epu8(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<u32>(_mm_cvtsi128_si32(r));
+}
+
+static u32 max_texel(__m256i a, __m256i b) {
+    __m256i m = _mm256_max_epu8(a, b);
+    __m128i r = _mm_max_epu8(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+    r = _mm_max_epu8(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(1, 0, 3, 2)));
+    r = _mm_max_epu8(r, _mm_shuffle_epi32(r, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<u32>(_mm_cvtsi128_si32(r));
+}
+
+static u16 rgb_to_565(u32 r, u32 g, u32 b) {
+    return static_cast<u16>(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+static void rgb_from_565(u16 c, i32* rgb) {
+    i32 r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Dot products of four RGBA texels, widened to 16 bits, with an RGB axis.
+static __m256i dot_texels(__m128i texels, __m256i axis) {
+    return _mm256_madd_epi16(_mm256_cvtepu8_epi16(texels), axis);
+}
+
+// Encodes the colors of a block of 16 RGBA texels. The endpoints are the corners of the colors'
+// bounding box inset by 1/16 of its extent, and each texel takes the palette entry nearest to its
+// projection onto the axis between them, as in van Waveren's Real-Time DXT Compression.
+static void bc1_block(u8* out, const u8* block) {
+
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+
+    u32 min = min_texel(lo, hi), max = max_texel(lo, hi);
+
+    u32 c_min[3], c_max[3];
+    for(u32 c = 0; c < 3; c++) {
+        u32 a = (min >> (8 * c)) & 0xff, b = (max >> (8 * c)) & 0xff;
+        u32 inset = (b - a) >> 4;
+        c_min[c] = a + inset;
+        c_max[c] = b - inset;
+    }
+
+    u16 c0 = rgb_to_565(c_max[0], c_max[1], c_max[2]);
+    u16 c1 = rgb_to_565(c_min[0], c_min[1], c_min[2]);
+    Libc::memcpy(out, &c0, 2);
+    Libc::memcpy(out + 2, &c1, 2);
+
+    i32 p0[3], p1[3];
+    rgb_from_565(c0, p0);
+    rgb_from_565(c1, p1);
+
+    i32 d[3] = {p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2]};
+    i32 dd = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+    u32 indices = 0;
+    if(dd > 0) {
+        __m256i axis = _mm256_set1_epi64x(static_cast<i64>(d[0]) | static_cast<i64>(d[1]) << 16 |
+                                          static_cast<i64>(d[2]) << 32);
+
+        // madd leaves (rg, ba) pairs per texel; hadd sums them but interleaves the lanes.
+        __m256i order = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+        __m256i dots0 = _mm256_permutevar8x32_epi32(
+            _mm256_hadd_epi32(dot_texels(_mm256_castsi256_si128(lo), axis),
+                              dot_texels(_mm256_extracti128_si256(lo, 1), axis)),
+            order);
+        __m256i dots1 = _mm256_permutevar8x32_epi32(
+            _mm256_hadd_epi32(dot_texels(_mm256_castsi256_si128(hi), axis),
+                              dot_texels(_mm256_extracti128_si256(hi, 1), axis)),
+            order);
+
+        __m256 base = _mm256_set1_ps(static_cast<f32>(p1[0] * d[0] + p1[1] * d[1] + p1[2] * d[2]));
+        __m256 scale = _mm256_set1_ps(3.0f / static_cast<f32>(dd));
+        __m256i zero = _mm256_setzero_si256(), three = _mm256_set1_epi32(3);
+
+        alignas(32) i32 levels[16];
+        for(u32 i = 0; i < 2; i++) {
+            __m256 t = _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(i ? dots1 : dots0), base),
+                                     scale);
+            __m256i level = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvtps_epi32(t), zero), three);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(levels + 8 * i), level);
+        }
+
+        // Levels count from c1 to c0; the palette stores c0, c1, then the two interpolants.
+        constexpr u32 palette[4] = {1, 3, 2, 0};
+        for(u32 i = 0; i < 16; i++) {
+            indices |= palette[levels[i]] << (2 * i);
+        }
+    }
+    Libc::memcpy(out + 4, &indices, 4);
+}
+
+// Encodes channel c of a block of 16 RGBA texels with eight interpolated values between the
+// block's minimum and maximum.
+static void bc4_block(u8* out, const u8* block, u32 c) {
+
+    alignas(16) u8 values[16];
+    for(u32 i = 0; i < 16; i++) {
+        values[i] = block[i * 4 + c];
+    }
+    __m128i v = _mm_load_si128(reinterpret_cast<const __m128i*>(values));
+
+    __m128i mn = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 2));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 1));
+    __m128i mx = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 2));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 1));
+
+    u32 min = static_cast<u32>(_mm_cvtsi128_si32(mn)) & 0xff;
+    u32 max = static_cast<u32>(_mm_cvtsi128_si32(mx)) & 0xff;
+    out[0] = static_cast<u8>(max);
+    out[1] = static_cast<u8>(min);
+
+    u64 indices = 0;
+    if(max > min) {
+        __m256 base = _mm256_set1_ps(static_cast<f32>(min));
+        __m256 scale = _mm256_set1_ps(7.0f / static_cast<f32>(max - min));
+
+        alignas(32) i32 levels[16];
+        for(u32 i = 0; i < 2; i++) {
+            __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(i ? _mm_srli_si128(v, 8) : v));
+            __m256i level = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_sub_ps(x, base), scale));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(levels + 8 * i), level);
+        }
+
+        // Levels count from min to max; the palette stores max, min, then the interpolants
+        // from max down to min.
+        constexpr u64 palette[8] = {1, 7, 6, 5, 4, 3, 2, 0};
+        for(u32 i = 0; i < 16; i++) {
+            indices |= palette[levels[i]] << (3 * i);
+        }
+    }
+    Libc::memcpy(out + 2, &indices, 6);
+}
+
+using Encode::B10_MAX;
+using Encode::HALF_MAX;
+using Encode::R11_MAX;
+using Encode::RGB9E5_MAX;
+
+// Texels converted per pass of the HDR kernels, a multiple of the eight texels per vector.
+static constexpr u32 HDR_CHUNK = 64;
+
+// Clamps to [lo, hi], reading NaN as zero.
+RPP_FORCE_INLINE static __m256 clamp_finite(__m256 x, __m256 lo, __m256 hi) {
+    x = _mm256_and_ps(x, _mm256_cmp_ps(x, x, _CMP_ORD_Q));
+    return _mm256_min_ps(_mm256_max_ps(x, lo), hi);
+}
+
+// Widens up to HDR_CHUNK texels of a 1-4 channel float image to RGBA, padded with zeros to a
+// multiple of eight texels. Missing channels read as zero, or one for alpha.
+static void load_rgba32f(f32* dst, const f32* src, u32 texels, u32 channels) {
+    if(channels == 4) {
+        Libc::memcpy(dst, src, static_cast<u64>(texels) * 4 * sizeof(f32));
+    } else {
+        for(u32 i = 0; i < texels; i++) {
+            const f32* texel = src + static_cast<u64>(i) * channels;
+            dst[i * 4 + 0] = texel[0];
+            dst[i * 4 + 1] = channels > 1 ? texel[1] : 0.0f;
+            dst[i * 4 + 2] = channels > 2 ? texel[2] : 0.0f;
+            dst[i * 4 + 3] = 1.0f;
+        }
+    }
+    u32 padded = (texels + 7) / 8 * 8;
+    for(u32 i = texels * 4; i < padded * 4; i++) dst[i] = 0.0f;
+}
+
+// Converts n floats to halves, rounding to nearest and clamping to the finite range.
+static void floats_to_halves(u16* out, const f32* in, u64 n) {
+    __m256 lo = _mm256_set1_ps(-HALF_MAX);
+    __m256 hi = _mm256_set1_ps(HALF_MAX);
+    u64 i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 x = clamp_finite(_mm256_loadu_ps(in + i), lo, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+    }
+    for(; i < n; i++) {
+        f32 x = in[i] == in[i] ? Math::min(Math::max(in[i], -HALF_MAX), HALF_MAX) : 0.0f;
+        out[i] = _cvtss_sh(x, _MM_FROUND_TO_NEAREST_INT);
+    }
+}
+
+// Gathers one channel of eight RGBA texels, clamped to [0, hi].
+RPP_FORCE_INLINE static __m256 gather_channel(const f32* rgba, u32 c, __m256 hi) {
+    __m256i index = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    return clamp_finite(_mm256_i32gather_ps(rgba + c, index, 4), ZERO, hi);
+}
+
+// Rounds eight non-negative floats to halves and keeps the top 16 - drop bits, rounding to
+// nearest. Mantissa rounding carries into the exponent like any float.
+RPP_FORCE_INLINE static __m256i round_half_bits(__m256 x, i32 drop) {
+    __m256i half = _mm256_cvtepu16_epi32(_mm256_cvtps_ph(x, _MM_FROUND_TO_NEAREST_INT));
+    __m256i bias = _mm256_set1_epi32(1 << (drop - 1));
+    return _mm256_srli_epi32(_mm256_add_epi32(half, bias), drop);
+}
+
+// Packs eight RGB texels into a shared exponent and 9 bit mantissas, following the
+// VK_FORMAT_E5B9G9R9_UFLOAT_PACK32 encoding in the Vulkan specification.
+RPP_FORCE_INLINE static __m256i pack_rgb9e5(__m256 r, __m256 g, __m256 b) {
+    __m256 m = _mm256_max_ps(r, _mm256_max_ps(g, b));
+
+    // floor(log2(m)) from the float exponent; zero and denormals clamp to the smallest exponent.
+    __m256i e = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(m), 23),
+                                 _mm256_set1_epi32(127));
+    e = _mm256_add_epi32(_mm256_max_epi32(e, _mm256_set1_epi32(-16)), _mm256_set1_epi32(16));
+
+    // Mantissas are scaled by 2^(24 - e); rounding the largest up to 512 bumps the exponent.
+    __m256 scale = _mm256_castsi256_ps(
+        _mm256_slli_epi32(_mm256_sub_epi32(_mm256_set1_epi32(151), e), 23));
+    __m256i top = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(m, scale), P5));
+    __m256i over = _mm256_cmpeq_epi32(top, _mm256_set1_epi32(512));
+    e = _mm256_sub_epi32(e, over);
+    scale = _mm256_blendv_ps(scale, _mm256_mul_ps(scale, P5), _mm256_castsi256_ps(over));
+
+    __m256i ri = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(r, scale), P5));
+    __m256i gi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(g, scale), P5));
+    __m256i bi = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(b, scale), P5));
+    return _mm256_or_si256(_mm256_or_si256(ri, _mm256_slli_epi32(gi, 9)),
+                           _mm256_or_si256(_mm256_slli_epi32(bi, 18), _mm256_slli_epi32(e, 27)));
+}
+
+// Gathers a 4x4 block of RGB texels at (x, y) as non-negative halves, clamping reads to the edges
+// of the image.
+static void load_block_half(u16* block, Slice<const f32> in, u32 w, u32 h, u32 channels, u32 x,
+                            u32 y) {
+    alignas(32) f32 rgb[48];
+    for(u32 j = 0; j < 4; j++) {
+        u64 row = static_cast<u64>(Math::min(y + j, h - 1)) * w;
+        for(u32 i = 0; i < 4; i++) {
+            const f32* src = in.data() + (row + Math::min(x + i, w - 1)) * channels;
+            f32* dst = rgb + (j * 4 + i) * 3;
+            dst[0] = src[0];
+            dst[1] = channels > 1 ? src[1] : 0.0f;
+            dst[2] = channels > 2 ? src[2] : 0.0f;
+        }
+    }
+    __m256 hi = _mm256_set1_ps(HALF_MAX);
+    for(u32 i = 0; i < 48; i += 8) {
+        __m256 texels = clamp_finite(_mm256_load_ps(rgb + i), ZERO, hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(block + i),
+                         _mm256_cvtps_ph(texels, _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
+// BC6H endpoints in mode 11 are 10 bits per channel. Unsigned decoding unquantizes them to 16
+// bits, interpolates, then scales by 31/64 back to half bits.
+static u32 bc6h_quantize(u32 half) {
+    return Math::min(half / 31, 1023u);
+}
+
+static i32 bc6h_unquantize(u32 x) {
+    if(x == 0) return 0;
+    if(x == 1023) return 0xffff;
+    return static_cast<i32>((x << 6) + 32);
+}
+
+struct Bits128 {
+    u64 lo = 0, hi = 0;
+    u32 offset = 0;
+
+    void put(u64 value, u32 bits) {
+        if(offset < 64) {
+            lo |= value << offset;
+            if(offset + bits > 64) hi |= value >> (64 - offset);
+        } else {
+            hi |= value << (offset - 64);
+        }
+        offset += bits;
+    }
+};
+
+// Encodes a block of 16 RGB halves in BC6H mode 11: one region with 10 bit endpoints and 4 bit
+// indices. The endpoints are the corners of the colors' bounding box, and each texel takes the
+// weight nearest to its projection onto the axis between them.
+static void bc6h_block(u8* out, const u16* block) {
+
+    u32 lo[3] = {0xffff, 0xffff, 0xffff}, hi[3] = {0, 0, 0};
+    for(u32 i = 0; i < 16; i++) {
+        for(u32 c = 0; c < 3; c++) {
+            lo[c] = Math::min(lo[c], static_cast<u32>(block[i * 3 + c]));
+            hi[c] = Math::max(hi[c], static_cast<u32>(block[i * 3 + c]));
+        }
+    }
+
+    u32 e0[3], e1[3];
+    f32 d0[3], axis[3], axis_length2 = 0.0f;
+    for(u32 c = 0; c < 3; c++) {
+        e0[c] = bc6h_quantize(lo[c]);
+        e1[c] = bc6h_quantize(hi[c]);
+        d0[c] = static_cast<f32>(bc6h_unquantize(e0[c]));
+        axis[c] = static_cast<f32>(bc6h_unquantize(e1[c])) - d0[c];
+        axis_length2 += axis[c] * axis[c];
+    }
+
+    // Texels are projected in the unquantized space, where the weights are round(64 i / 15).
+    u32 indices[16] = {};
+    if(axis_length2 > 0.0f) {
+        f32 inv = 15.0f / axis_length2;
+        for(u32 i = 0; i < 16; i++) {
+            f32 t = 0.0f;
+            for(u32 c = 0; c < 3; c++) {
+                t += (static_cast<f32>(block[i * 3 + c]) * (64.0f / 31.0f) - d0[c]) * axis[c];
+            }
+            indices[i] = static_cast<u32>(Math::min(Math::max(t * inv + 0.5f, 0.0f), 15.0f));
+        }
+    }
+
+    // The first texel's index drops its top bit, so it must be in the lower half of the palette.
+    if(indices[0] >= 8) {
+        for(u32 c = 0; c < 3; c++) swap(e0[c], e1[c]);
+        for(u32 i = 0; i < 16; i++) indices[i] = 15 - indices[i];
+    }
+
+    Bits128 bits;
+    bits.put(0x03, 5);
+    for(u32 c = 0; c < 3; c++) bits.put(e0[c], 10);
+    for(u32 c = 0; c < 3; c++) bits.put(e1[c], 10);
+    bits.put(indices[0], 3);
+    for(u32 i = 1; i < 16; i++) bits.put(indices[i], 4);
+
+    Libc::memcpy(out, &bits.lo, 8);
+    Libc::memcpy(out + 8, &bits.hi, 8);
+}
+
 namespace Encode {
 
 u32 uv_half(Vec2 uv) {
@@ -327,6 +688,16 @@ u64 mesh(u8* out, Slice<const f32> uvs, Slice<const f32> normals, Slice<const f3
     return offset;
 }
 
+void indices16(u8* out, Slice<const u32> in) {
+
+    // TODO simd
+
+    u16* out16 = reinterpret_cast<u16*>(out);
+    for(u64 i = 0; i < in.length(); i++) {
+        out16[i] = static_cast<u16>(in[i]);
+    }
+}
+
 void rg8_to_rgba8(u8* out, Slice<const u8> in, u32 w, u32 h) {
 
     // TODO simd
@@ -383,4 +754,240 @@ void rgb32f_to_rgba32f(u8* out, Slice<const f32> in, u32 w, u32 h) {
     }
 }
 
+void halve8(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels) {
+
+    u32 out_w = Math::max(w / 2, 1u);
+    u32 out_h = Math::max(h / 2, 1u);
+    u16 sums[HALVE_CHUNK * 4];
+
+    for(u32 y = 0; y < out_h; y++) {
+        const u8* row0 = in.data() + static_cast<u64>(2 * y) * w * channels;
+        const u8* row1 = in.data() + static_cast<u64>(Math::min(2 * y + 1, h - 1)) * w * channels;
+        u8* dst = out + static_cast<u64>(y) * out_w * channels;
+
+        for(u32 x = 0; x < out_w; x += HALVE_CHUNK / 2) {
+
+            // Sum pairs of rows in 16 bit lanes so the result rounds like a 2x2 average.
+            u32 texels = Math::min(HALVE_CHUNK, w - 2 * x);
+            u32 n = texels * channels;
+            const u8* src0 = row0 + static_cast<u64>(2 * x) * channels;
+            const u8* src1 = row1 + static_cast<u64>(2 * x) * channels;
+
+            u32 i = 0;
+            for(; i + 16 <= n; i += 16) {
+                __m256i a = _mm256_cvtepu8_epi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(src0 + i)));
+                __m256i b = _mm256_cvtepu8_epi16(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(src1 + i)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + i), _mm256_add_epi16(a, b));
+            }
+            for(; i < n; i++) {
+                sums[i] = static_cast<u16>(src0[i] + src1[i]);
+            }
+
+            u32 pairs = Math::min(HALVE_CHUNK / 2, out_w - x);
+            for(u32 p = 0; p < pairs; p++) {
+                u32 left = 2 * p * channels;
+                u32 right = Math::min(2 * p + 1, texels - 1) * channels;
+                for(u32 c = 0; c < channels; c++) {
+                    u32 sum = sums[left + c] + sums[right + c];
+                    dst[(x + p) * channels + c] = static_cast<u8>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+void halve32f(f32* out, Slice<const f32> in, u32 w, u32 h, u32 channels) {
+
+    u32 out_w = Math::max(w / 2, 1u);
+    u32 out_h = Math::max(h / 2, 1u);
+    f32 sums[HALVE_CHUNK * 4];
+
+    for(u32 y = 0; y < out_h; y++) {
+        const f32* row0 = in.data() + static_cast<u64>(2 * y) * w * channels;
+        const f32* row1 = in.data() + static_cast<u64>(Math::min(2 * y + 1, h - 1)) * w * channels;
+        f32* dst = out + static_cast<u64>(y) * out_w * channels;
+
+        for(u32 x = 0; x < out_w; x += HALVE_CHUNK / 2) {
+
+            u32 texels = Math::min(HALVE_CHUNK, w - 2 * x);
+            u32 n = texels * channels;
+            const f32* src0 = row0 + static_cast<u64>(2 * x) * channels;
+            const f32* src1 = row1 + static_cast<u64>(2 * x) * channels;
+
+            u32 i = 0;
+            for(; i + 8 <= n; i += 8) {
+                __m256 a = _mm256_loadu_ps(src0 + i);
+                __m256 b = _mm256_loadu_ps(src1 + i);
+                _mm256_storeu_ps(sums + i, _mm256_mul_ps(_mm256_add_ps(a, b), P25));
+            }
+            for(; i < n; i++) {
+                sums[i] = (src0[i] + src1[i]) * 0.25f;
+            }
+
+            u32 pairs = Math::min(HALVE_CHUNK / 2, out_w - x);
+            for(u32 p = 0; p < pairs; p++) {
+                u32 left = 2 * p * channels;
+                u32 right = Math::min(2 * p + 1, texels - 1) * channels;
+                for(u32 c = 0; c < channels; c++) {
+                    dst[(x + p) * channels + c] = sums[left + c] + sums[right + c];
+                }
+            }
+        }
+    }
+}
+
+
+void bc1(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels) {
+    alignas(32) u8 block[64];
+    for(u32 y = 0; y < h; y += 4) {
+        for(u32 x = 0; x < w; x += 4) {
+            load_block(block, in, w, h, channels, x, y);
+            bc1_block(out, block);
+            out += 8;
+        }
+    }
+}
+
+void bc3(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels) {
+    alignas(32) u8 block[64];
+    for(u32 y = 0; y < h; y += 4) {
+        for(u32 x = 0; x < w; x += 4) {
+            load_block(block, in, w, h, channels, x, y);
+            bc4_block(out, block, 3);
+            bc1_block(out + 8, block);
+            out += 16;
+        }
+    }
+}
+
+void bc4(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels) {
+    alignas(32) u8 block[64];
+    for(u32 y = 0; y < h; y += 4) {
+        for(u32 x = 0; x < w; x += 4) {
+            load_block(block, in, w, h, channels, x, y);
+            bc4_block(out, block, 0);
+            out += 8;
+        }
+    }
+}
+
+void bc5(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels) {
+    alignas(32) u8 block[64];
+    for(u32 y = 0; y < h; y += 4) {
+        for(u32 x = 0; x < w; x += 4) {
+            load_block(block, in, w, h, channels, x, y);
+            bc4_block(out, block, 0);
+            bc4_block(out + 8, block, 1);
+            out += 16;
+        }
+    }
+}
+
+void r16f(u8* out, Slice<const f32> in, u32 w, u32 h) {
+    floats_to_halves(reinterpret_cast<u16*>(out), in.data(), static_cast<u64>(w) * h);
+}
+
+void rgba16f(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels) {
+    alignas(32) f32 rgba[HDR_CHUNK * 4];
+    u64 n = static_cast<u64>(w) * h;
+    u16* out16 = reinterpret_cast<u16*>(out);
+    for(u64 i = 0; i < n; i += HDR_CHUNK) {
+        u32 texels = static_cast<u32>(Math::min(static_cast<u64>(HDR_CHUNK), n - i));
+        load_rgba32f(rgba, in.data() + i * channels, texels, channels);
+        floats_to_halves(out16 + i * 4, rgba, static_cast<u64>(texels) * 4);
+    }
+}
+
+void b10g11r11f(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels) {
+    alignas(32) f32 rgba[HDR_CHUNK * 4];
+    alignas(32) u32 packed[8];
+    u64 n = static_cast<u64>(w) * h;
+    u32* out32 = reinterpret_cast<u32*>(out);
+    __m256 r_max = _mm256_set1_ps(R11_MAX), b_max = _mm256_set1_ps(B10_MAX);
+    for(u64 i = 0; i < n; i += HDR_CHUNK) {
+        u32 texels = static_cast<u32>(Math::min(static_cast<u64>(HDR_CHUNK), n - i));
+        load_rgba32f(rgba, in.data() + i * channels, texels, channels);
+        for(u32 j = 0; j < texels; j += 8) {
+            // R and G keep 6 of the half's 10 mantissa bits, B keeps 5.
+            __m256i r = round_half_bits(gather_channel(rgba + j * 4, 0, r_max), 4);
+            __m256i g = round_half_bits(gather_channel(rgba + j * 4, 1, r_max), 4);
+            __m256i b = round_half_bits(gather_channel(rgba + j * 4, 2, b_max), 5);
+            __m256i rgb = _mm256_or_si256(
+                r, _mm256_or_si256(_mm256_slli_epi32(g, 11), _mm256_slli_epi32(b, 22)));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(packed), rgb);
+            Libc::memcpy(out32 + i + j, packed, Math::min(8u, texels - j) * sizeof(u32));
+        }
+    }
+}
+
+void e5b9g9r9f(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels) {
+    alignas(32) f32 rgba[HDR_CHUNK * 4];
+    alignas(32) u32 packed[8];
+    u64 n = static_cast<u64>(w) * h;
+    u32* out32 = reinterpret_cast<u32*>(out);
+    __m256 hi = _mm256_set1_ps(RGB9E5_MAX);
+    for(u64 i = 0; i < n; i += HDR_CHUNK) {
+        u32 texels = static_cast<u32>(Math::min(static_cast<u64>(HDR_CHUNK), n - i));
+        load_rgba32f(rgba, in.data() + i * channels, texels, channels);
+        for(u32 j = 0; j < texels; j += 8) {
+            __m256i rgb = pack_rgb9e5(gather_channel(rgba + j * 4, 0, hi),
+                                      gather_channel(rgba + j * 4, 1, hi),
+                                      gather_channel(rgba + j * 4, 2, hi));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(packed), rgb);
+            Libc::memcpy(out32 + i + j, packed, Math::min(8u, texels - j) * sizeof(u32));
+        }
+    }
+}
+
+void bc6h(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels) {
+    alignas(32) u16 block[48];
+    for(u32 y = 0; y < h; y += 4) {
+        for(u32 x = 0; x < w; x += 4) {
+            load_block_half(block, in, w, h, channels, x, y);
+            bc6h_block(out, block);
+            out += 16;
+        }
+    }
+}
+
+HDR_Range hdr_range(Slice<const f32> in, u32 channels) {
+
+    // With four channels, lanes 3 and 7 of each vector hold alpha.
+    __m256 alpha = channels == 4 ? _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1))
+                                 : ZERO;
+    __m256 lo = ZERO, hi = ZERO, translucent = ZERO;
+
+    u64 n = in.length();
+    u64 i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(in.data() + i);
+        __m256 color = _mm256_andnot_ps(alpha, x);
+        // NaN compares as neither smaller nor larger, so it leaves the range unchanged.
+        lo = _mm256_min_ps(color, lo);
+        hi = _mm256_max_ps(color, hi);
+        translucent =
+            _mm256_or_ps(translucent, _mm256_and_ps(alpha, _mm256_cmp_ps(x, ONE, _CMP_NEQ_UQ)));
+    }
+
+    alignas(32) f32 lanes[8];
+    HDR_Range range;
+    _mm256_store_ps(lanes, lo);
+    for(f32 l : lanes) range.min = Math::min(range.min, l);
+    _mm256_store_ps(lanes, hi);
+    for(f32 l : lanes) range.max = Math::max(range.max, l);
+    range.opaque = _mm256_movemask_ps(translucent) == 0;
+
+    for(; i < n; i++) {
+        if(channels == 4 && i % 4 == 3) {
+            if(in[i] != 1.0f) range.opaque = false;
+        } else if(in[i] == in[i]) {
+            range.min = Math::min(range.min, in[i]);
+            range.max = Math::max(range.max, in[i]);
+        }
+    }
+    return range;
+}
+
 } // namespace Encode
\ No newline at end of file
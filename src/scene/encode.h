@@ -13,6 +13,7 @@ u32 uv_half(Vec2 uv);
 u16 tangent_diamond(Vec3 normal, Vec3 tangent);
 
 u64 mesh(u8* out, Slice<const f32> uvs, Slice<const f32> normals, Slice<const f32> tangents);
+void indices16(u8* out, Slice<const u32> in);
 
 void rg8_to_rgba8(u8* out, Slice<const u8> in, u32 w, u32 h);
 void rgb8_to_rgba8(u8* out, Slice<const u8> in, u32 w, u32 h);
@@ -20,4 +21,41 @@ void rgb8_to_rgba8(u8* out, Slice<const u8> in, u32 w, u32 h);
 void rg32f_to_rgba32f(u8* out, Slice<const f32> in, u32 w, u32 h);
 void rgb32f_to_rgba32f(u8* out, Slice<const f32> in, u32 w, u32 h);
 
+// Converts a w x h float image to compact HDR texels. Missing channels read as zero, or one for
+// alpha. Values clamp to each format's finite range; the packed formats and BC6H are unsigned and
+// drop alpha. BC6H writes rows of 4x4 blocks like the 8 bit block encoders.
+void r16f(u8* out, Slice<const f32> in, u32 w, u32 h);
+void rgba16f(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels);
+void b10g11r11f(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels);
+void e5b9g9r9f(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels);
+void bc6h(u8* out, Slice<const f32> in, u32 w, u32 h, u32 channels);
+
+// Largest finite values of the HDR formats. The packed formats are unsigned and share the half
+// exponent bias.
+constexpr f32 HALF_MAX = 65504.0f;
+constexpr f32 R11_MAX = 65024.0f;
+constexpr f32 B10_MAX = 64512.0f;
+constexpr f32 RGB9E5_MAX = 65408.0f;
+
+// Range of an HDR image's color values, widened to include zero, and whether its alpha is all one.
+struct HDR_Range {
+    f32 min = 0.0f;
+    f32 max = 0.0f;
+    bool opaque = true;
+};
+HDR_Range hdr_range(Slice<const f32> in, u32 channels);
+
+// Box filters a w x h image down to max(w / 2, 1) x max(h / 2, 1). Odd last rows and columns are
+// dropped, and an extent of one is averaged with itself.
+void halve8(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels);
+void halve32f(f32* out, Slice<const f32> in, u32 w, u32 h, u32 channels);
+
+// Block compresses a w x h 8 bit image into rows of 4x4 blocks. Texels past the right and bottom
+// edges repeat the last column and row. BC1 encodes RGB, BC3 RGBA, BC4 R, and BC5 RG; channels
+// missing from the input read as zero, or opaque for alpha.
+void bc1(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels);
+void bc3(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels);
+void bc4(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels);
+void bc5(u8* out, Slice<const u8> in, u32 w, u32 h, u32 channels);
+
 } // namespace Encode
\ No newline at end of file
@@ -10,6 +10,17 @@ struct Loader {
     Vec<Async::Task<Texture>, Alloc> textures;
 };
 
+// Passed to load_image_data, which records the images it leaves for load_texture to look up in
+// the texture cache.
+struct Image_Loader {
+    const Texture_Cache::Config* texture_cache = null;
+    Vec<bool, Alloc> deferred;
+
+    [[nodiscard]] bool is_deferred(i32 image) const {
+        return static_cast<u64>(image) < deferred.length() && deferred[image];
+    }
+};
+
 static Async::Task<Primitive> load_primitive(Async::Pool<>& pool, const tinygltf::Model& gmodel,
                                              const tinygltf::Primitive& gprimitive) {
 
@@ -297,12 +308,53 @@ static u32 load_node(Scene& scene, const tinygltf::Model& model, u32 node_idx) {
     return id;
 }
 
-Async::Task<Texture> load_texture(Async::Pool<>& pool, const tinygltf::Model& model,
-                                  const tinygltf::Texture& texture) {
+// KTX2 and DDS images are kept as-is for load_texture. So are all other images when the texture
+// cache is enabled, since tinygltf calls this serially: load_texture hashes them and only decodes
+// those missing from the cache, on the pool. Otherwise images are decoded by tinygltf.
+static bool load_image_data(tinygltf::Image* image, const int image_idx, std::string* err,
+                            std::string* warn, int req_width, int req_height,
+                            const unsigned char* bytes, int size, void* user_data) {
+
+    auto& loader = *static_cast<Image_Loader*>(user_data);
+    bool container = Compressed::is_container(Slice<const u8>{bytes, static_cast<u64>(size)});
+
+    if(container || loader.texture_cache) {
+        image->as_is = true;
+        image->image.assign(bytes, bytes + size);
+        if(!container) {
+            while(loader.deferred.length() <= static_cast<u64>(image_idx)) {
+                loader.deferred.push(false);
+            }
+            loader.deferred[image_idx] = true;
+        }
+        return true;
+    }
+    return tinygltf::LoadImageData(image, image_idx, err, warn, req_width, req_height, bytes,
+                                   size, null);
+}
 
-    if(static_cast<u64>(texture.source) >= model.images.size()) co_return {};
+// Textures may name a KTX2 or DDS image through an extension, keeping source as a fallback.
+static i32 compressed_source(const tinygltf::Texture& texture) {
+    for(const char* name : {"KHR_texture_basisu", "MSFT_texture_dds"}) {
+        auto ext = texture.extensions.find(name);
+        if(ext != texture.extensions.end() && ext->second.Has("source")) {
+            return ext->second.Get("source").GetNumberAsInt();
+        }
+    }
+    return texture.source;
+}
+
+static Texture compressed_texture(Compressed::Image image) {
+    Texture ret;
+    ret.width = image.w;
+    ret.height = image.h;
+    ret.components = 4;
+    ret.compressed = move(image);
+    return ret;
+}
+
+static Texture decoded_texture(const tinygltf::Image& image) {
 
-    const auto& image = model.images[texture.source];
     const auto size = image.component * image.width * image.height * sizeof(u8);
 
     Vec<u8, Alloc> data(size);
@@ -310,11 +362,64 @@ Async::Task<Texture> load_texture(Async::Pool<>& pool, const tinygltf::Model& mo
 
     Libc::memcpy(data.data(), image.image.data(), size);
 
-    co_return Texture{std::move(data), static_cast<u32>(image.width),
-                      static_cast<u32>(image.height), static_cast<u32>(image.component)};
+    return Texture{std::move(data), static_cast<u32>(image.width),
+                   static_cast<u32>(image.height), static_cast<u32>(image.component)};
+}
+
+// Images found in the texture cache are read in place from the mapped entry. Others are decoded
+// here and keep their key, so the upload stores them once they are encoded.
+static Texture cached_texture(const tinygltf::Image& image, i32 image_idx,
+                              const Texture_Cache::Config& texture_cache) {
+
+    Slice<const u8> file{image.image.data(), image.image.size()};
+    u64 key = Texture_Cache::key(texture_cache, file, true);
+    if(auto stored = Texture_Cache::read(texture_cache, key); stored.ok()) {
+        return compressed_texture(move(*stored));
+    }
+
+    tinygltf::Image decoded;
+    std::string err, warn;
+    if(!tinygltf::LoadImageData(&decoded, image_idx, &err, &warn, 0, 0, file.data(),
+                                static_cast<i32>(file.length()), null)) {
+        warn("[gltf] Failed to decode image %: %.", image_idx, String_View{err.c_str()});
+        return {};
+    }
+
+    Texture ret = decoded_texture(decoded);
+    ret.cache_key = key;
+    return ret;
 }
 
-Async::Task<Scene> load(Async::Pool<>& pool, String_View file) {
+Async::Task<Texture> load_texture(Async::Pool<>& pool, const tinygltf::Model& model,
+                                  const tinygltf::Texture& texture, const Image_Loader& images) {
+
+    i32 source = compressed_source(texture);
+    if(static_cast<u64>(source) < model.images.size() && model.images[source].as_is &&
+       !images.is_deferred(source)) {
+
+        co_await pool.suspend();
+
+        const auto& image = model.images[source];
+        auto compressed =
+            Compressed::load(String_View{image.uri.c_str()},
+                             Slice<const u8>{image.image.data(), image.image.size()});
+        if(compressed.ok()) co_return compressed_texture(move(*compressed));
+    }
+
+    if(static_cast<u64>(texture.source) >= model.images.size()) co_return {};
+
+    const auto& image = model.images[texture.source];
+    if(images.is_deferred(texture.source)) {
+        co_await pool.suspend();
+        co_return cached_texture(image, texture.source, *images.texture_cache);
+    }
+    if(image.as_is) co_return {};
+
+    co_return decoded_texture(image);
+}
+
+Async::Task<Scene> load(Async::Pool<>& pool, String_View file,
+                        const Texture_Cache::Config* texture_cache) {
 
     co_await pool.suspend();
 
@@ -325,6 +430,10 @@ Async::Task<Scene> load(Async::Pool<>& pool, String_View file) {
 
     std::string err, warn;
 
+    Image_Loader image_loader;
+    image_loader.texture_cache = texture_cache;
+    gloader.SetImageLoader(load_image_data, &image_loader);
+
     bool ok = false;
     if(file.file_extension() == "glb"_v) {
         ok = gloader.LoadBinaryFromFile(
@@ -356,7 +465,7 @@ Async::Task<Scene> load(Async::Pool<>& pool, String_View file) {
         loader.meshes.push(load_mesh(pool, model, mesh));
     }
     for(const auto& texture : model.textures) {
-        loader.textures.push(load_texture(pool, model, texture));
+        loader.textures.push(load_texture(pool, model, texture, image_loader));
     }
 
     for(auto& gscene : model.scenes) {
@@ -6,6 +6,9 @@
 #include <rpp/pool.h>
 #include <rpp/vmath.h>
 
+#include "compressed.h"
+#include "texture_cache.h"
+
 using namespace rpp;
 
 namespace GLTF {
@@ -71,6 +74,10 @@ struct Texture {
     u32 width = 0;
     u32 height = 0;
     u32 components = 0;
+    // Set instead of data for KTX2 and DDS images, and for images found in the texture cache.
+    Compressed::Image compressed;
+    // Texture cache entry the upload writes once the decoded image is encoded, if any.
+    u64 cache_key = 0;
 };
 
 struct Scene {
@@ -82,6 +89,7 @@ struct Scene {
     Vec<u32, Alloc> top_level_nodes;
 };
 
-Async::Task<Scene> load(Async::Pool<>& pool, String_View file);
+Async::Task<Scene> load(Async::Pool<>& pool, String_View file,
+                        const Texture_Cache::Config* texture_cache = null);
 
 } // namespace GLTF
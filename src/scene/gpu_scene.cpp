@@ -1,4 +1,8 @@
 
+#include <rpp/thread.h>
+
+#include "../util/hash.h"
+
 #include "gpu_scene.h"
 #include "encode.h"
 
@@ -40,11 +44,60 @@ static void transfer_build_barrier(rvk::Commands& cmds) {
     vkCmdPipelineBarrier2(cmds, &dep);
 }
 
+static void memory_barrier(rvk::Commands& cmds, VkPipelineStageFlags2 src_stage,
+                           VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage,
+                           VkAccessFlags2 dst_access) {
+
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = src_stage,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stage,
+        .dstAccessMask = dst_access,
+    };
+
+    VkDependencyInfo dep = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+
+    vkCmdPipelineBarrier2(cmds, &dep);
+}
+
 namespace GPU_Scene {
 
 static constexpr u32 MAX_IMAGES = 2048;
 static constexpr u32 MAX_SAMPLERS = 64;
 
+// Top level clusters with more than this many triangles are split further, unless no split lowers
+// the SAH cost. Every cluster adds a TLAS instance and a BLAS root to traverse, which the SAH
+// charges as CLUSTER_COST triangle intersections.
+static constexpr u64 MIN_CLUSTER_TRIANGLES = 1 << 16;
+static constexpr u64 CLUSTER_BINS = 16;
+static constexpr f32 CLUSTER_COST = 1024.0f;
+
+// Objects are uploaded in batches that share staging chunks and submissions.
+static constexpr u64 BATCH_BYTES = Math::MB(16);
+static constexpr u64 BATCH_OBJECTS = 256;
+
+Config Config::automatic(u64 host_heap, u64 device_heap) {
+    Config config;
+    // Leave half of the host heap for other transfers and most of the device heap for the
+    // resources that have already finished uploading.
+    config.staging_budget = host_heap / 2;
+    config.device_budget = device_heap / 4;
+    config.max_blas_bytes = config.device_budget / 4;
+    // Geometry and acceleration structures take the other half.
+    config.texture_budget = device_heap / 2;
+    config.max_uploads = 2 * Thread::hardware_threads();
+    return config;
+}
+
+u64 Config::texture_cache_settings() const {
+    return static_cast<u64>(compress_textures) | static_cast<u64>(hdr_format) << 8;
+}
+
 static Material_Type convert_material_type(PBRT::Materials::Type type) {
     switch(type) {
     case PBRT::Materials::Type::conductor: {
@@ -108,6 +161,10 @@ static GPU_Material convert_material(const PBRT::Scene& cpu, const PBRT::Materia
             }
             RPP_UNREACHABLE;
         } else if(tex.type == PBRT::Textures::Type::imagemap) {
+            // Snapshots are taken before any image is bound and read image textures as gray.
+            if(id.id >= texture_to_image_index.length()) {
+                return Pair{Vec4{0.5f}, GPU_Texture_ID::constant()};
+            }
             u64 idx = texture_to_image_index[id.id];
             u64 sampler_idx = texture_to_sampler_index[id.id];
             auto tid = idx >= MAX_IMAGES || sampler_idx >= MAX_SAMPLERS
@@ -419,8 +476,184 @@ struct Mesh_Ref {
 
         return true;
     }
+
+    [[nodiscard]] u64 vertex_count() const {
+        return positions.length() / 3;
+    }
+    // Meshes with at most 2^16 vertices store 16-bit indices.
+    [[nodiscard]] bool index16() const {
+        return vertex_count() <= (1 << 16);
+    }
+    [[nodiscard]] u64 index_bytes() const {
+        return indices.length() * (index16() ? sizeof(u16) : sizeof(u32));
+    }
+};
+
+struct Bounds {
+    Vec3 min = Vec3{RPP_FLT_MAX};
+    Vec3 max = Vec3{-RPP_FLT_MAX};
+
+    void enclose(Vec3 p) {
+        min = Vec3{Math::min(min.x, p.x), Math::min(min.y, p.y), Math::min(min.z, p.z)};
+        max = Vec3{Math::max(max.x, p.x), Math::max(max.y, p.y), Math::max(max.z, p.z)};
+    }
+    void enclose(const Bounds& b) {
+        enclose(b.min);
+        enclose(b.max);
+    }
+    bool empty() const {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+    Vec3 center() const {
+        return (min + max) * 0.5f;
+    }
+    f32 surface_area() const {
+        if(empty()) return 0.0f;
+        Vec3 e = max - min;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+};
+
+static Bounds mesh_bounds(const Mesh_Ref& mesh) {
+    Bounds local;
+    for(u64 i = 0; i + 2 < mesh.positions.length(); i += 3) {
+        local.enclose(Vec3{mesh.positions[i], mesh.positions[i + 1], mesh.positions[i + 2]});
+    }
+    if(local.empty()) return local;
+
+    Bounds ret;
+    for(u32 c = 0; c < 8; c++) {
+        Vec3 corner{c & 1 ? local.max.x : local.min.x, c & 2 ? local.max.y : local.min.y,
+                    c & 4 ? local.max.z : local.min.z};
+        ret.enclose((mesh.T * Vec4{corner, 1.0f}).xyz());
+    }
+    return ret;
+}
+
+struct Cluster_Item {
+    Bounds bounds;
+    Vec3 centroid;
+    u64 triangles = 0;
+    u64 mesh = 0;
 };
 
+// Binned SAH over mesh centroids. Items are partitioned in place, and the [begin, end) ranges of
+// the resulting clusters are appended to out.
+static void partition_clusters(Slice<Cluster_Item> items, u64 begin, u64 end,
+                               Vec<Pair<u64, u64>, Alloc>& out) {
+
+    Bounds bounds, centroids;
+    u64 triangles = 0;
+    for(u64 i = begin; i < end; i++) {
+        bounds.enclose(items[i].bounds);
+        centroids.enclose(items[i].centroid);
+        triangles += items[i].triangles;
+    }
+
+    if(end - begin <= 1 || triangles <= MIN_CLUSTER_TRIANGLES) {
+        out.push(Pair{begin, end});
+        return;
+    }
+
+    Vec3 extent = centroids.max - centroids.min;
+    u32 axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+    f32 axis_min = centroids.min[axis];
+    f32 axis_extent = extent[axis];
+
+    if(axis_extent <= 0.0f) {
+        out.push(Pair{begin, end});
+        return;
+    }
+
+    auto bin_of = [&](const Cluster_Item& item) {
+        f32 t = (item.centroid[axis] - axis_min) / axis_extent;
+        return Math::min(static_cast<u64>(t * CLUSTER_BINS), CLUSTER_BINS - 1);
+    };
+
+    Bounds bin_bounds[CLUSTER_BINS];
+    u64 bin_triangles[CLUSTER_BINS] = {};
+    for(u64 i = begin; i < end; i++) {
+        u64 b = bin_of(items[i]);
+        bin_bounds[b].enclose(items[i].bounds);
+        bin_triangles[b] += items[i].triangles;
+    }
+
+    f32 right_cost[CLUSTER_BINS] = {};
+    {
+        Bounds right;
+        u64 right_triangles = 0;
+        for(u64 b = CLUSTER_BINS - 1; b > 0; b--) {
+            right.enclose(bin_bounds[b]);
+            right_triangles += bin_triangles[b];
+            right_cost[b] =
+                right.surface_area() * (static_cast<f32>(right_triangles) + CLUSTER_COST);
+        }
+    }
+
+    f32 best_cost = bounds.surface_area() * (static_cast<f32>(triangles) + CLUSTER_COST);
+    u64 best_split = 0;
+    {
+        Bounds left;
+        u64 left_triangles = 0;
+        for(u64 b = 0; b + 1 < CLUSTER_BINS; b++) {
+            left.enclose(bin_bounds[b]);
+            left_triangles += bin_triangles[b];
+            if(left_triangles == 0 || left_triangles == triangles) continue;
+            f32 cost = left.surface_area() * (static_cast<f32>(left_triangles) + CLUSTER_COST) +
+                       right_cost[b + 1];
+            if(cost < best_cost) {
+                best_cost = cost;
+                best_split = b + 1;
+            }
+        }
+    }
+
+    if(best_split == 0) {
+        out.push(Pair{begin, end});
+        return;
+    }
+
+    u64 mid = begin;
+    for(u64 i = begin; i < end; i++) {
+        if(bin_of(items[i]) < best_split) {
+            swap(items[i], items[mid]);
+            mid++;
+        }
+    }
+
+    partition_clusters(items, begin, mid, out);
+    partition_clusters(items, mid, end, out);
+}
+
+static Vec<Vec<Mesh_Ref, Alloc>, Alloc> cluster_meshes(Slice<const Mesh_Ref> meshes) {
+
+    Vec<Vec<Mesh_Ref, Alloc>, Alloc> clusters;
+    if(meshes.empty()) return clusters;
+
+    Vec<Cluster_Item, Alloc> items(meshes.length());
+    for(u64 i = 0; i < meshes.length(); i++) {
+        Bounds bounds = mesh_bounds(meshes[i]);
+        items.push(Cluster_Item{
+            .bounds = bounds,
+            .centroid = bounds.empty() ? Vec3{} : bounds.center(),
+            .triangles = meshes[i].indices.length() / 3,
+            .mesh = i,
+        });
+    }
+
+    Vec<Pair<u64, u64>, Alloc> ranges;
+    partition_clusters(items.slice(), 0, items.length(), ranges);
+
+    for(auto [begin, end] : ranges) {
+        Vec<Mesh_Ref, Alloc> cluster(end - begin);
+        for(u64 i = begin; i < end; i++) {
+            cluster.push(meshes[items[i].mesh]);
+        }
+        clusters.push(move(cluster));
+    }
+    return clusters;
+}
+
 struct Staging_Full {};
 struct Device_Full {};
 
@@ -443,8 +676,13 @@ struct Lights_Buffers {
     Slice<const Pair<Mat4, u32>> lights;
 };
 
+// Materials and lights keep their staging buffer as the shadow of the device buffer.
+struct Shadowed_Upload {
+    rvk::Buffer device;
+    rvk::Buffer shadow;
+};
+
 struct Geometry_Buffers {
-    rvk::Buffer staging;
     rvk::Buffer device;
     Slice<const Mesh_Ref> meshes;
 };
@@ -458,12 +696,15 @@ struct Geometry_Reference_Buffers {
 };
 
 struct BLAS_Buffers {
-    rvk::Buffer staging;
     rvk::Buffer device;
     rvk::BLAS::Buffers blas;
     Slice<const Mesh_Ref> meshes;
 };
 
+struct BLAS_Batch_Buffers {
+    Vec<BLAS_Buffers, Alloc> objects;
+};
+
 struct TLAS_Buffers {
     rvk::Buffer staging;
     rvk::Buffer device;
@@ -471,12 +712,166 @@ struct TLAS_Buffers {
     Slice<const rvk::TLAS::Instance> instances;
 };
 
+// Device layout of an image's texels. Block compressed images store 4x4 blocks of 8 or 16 bytes.
+enum class Image_Encoding : u8 {
+    r8,
+    rgba8,
+    bc1,
+    bc1a,
+    bc2,
+    bc3,
+    bc4,
+    bc5,
+    bc6h,
+    bc7,
+    r32f,
+    rgba32f,
+    r16f,
+    rgba16f,
+    b10g11r11f,
+    e5b9g9r9f,
+};
+
+static bool is_block_compressed(Image_Encoding encoding) {
+    return encoding >= Image_Encoding::bc1 && encoding <= Image_Encoding::bc7;
+}
+
+static Image_Encoding precompressed_encoding(Compressed::Format format) {
+    switch(format) {
+    case Compressed::Format::bc1: return Image_Encoding::bc1;
+    case Compressed::Format::bc1a: return Image_Encoding::bc1a;
+    case Compressed::Format::bc2: return Image_Encoding::bc2;
+    case Compressed::Format::bc3: return Image_Encoding::bc3;
+    case Compressed::Format::bc4: return Image_Encoding::bc4;
+    case Compressed::Format::bc5: return Image_Encoding::bc5;
+    case Compressed::Format::bc6h: return Image_Encoding::bc6h;
+    case Compressed::Format::bc7: return Image_Encoding::bc7;
+    case Compressed::Format::r8: return Image_Encoding::r8;
+    case Compressed::Format::rgba8: return Image_Encoding::rgba8;
+    case Compressed::Format::r16f: return Image_Encoding::r16f;
+    case Compressed::Format::rgba16f: return Image_Encoding::rgba16f;
+    case Compressed::Format::b10g11r11f: return Image_Encoding::b10g11r11f;
+    case Compressed::Format::e5b9g9r9f: return Image_Encoding::e5b9g9r9f;
+    case Compressed::Format::r32f: return Image_Encoding::r32f;
+    case Compressed::Format::rgba32f: return Image_Encoding::rgba32f;
+    }
+    RPP_UNREACHABLE;
+}
+
+static Compressed::Format cached_format(Image_Encoding encoding) {
+    switch(encoding) {
+    case Image_Encoding::r8: return Compressed::Format::r8;
+    case Image_Encoding::rgba8: return Compressed::Format::rgba8;
+    case Image_Encoding::bc1: return Compressed::Format::bc1;
+    case Image_Encoding::bc1a: return Compressed::Format::bc1a;
+    case Image_Encoding::bc2: return Compressed::Format::bc2;
+    case Image_Encoding::bc3: return Compressed::Format::bc3;
+    case Image_Encoding::bc4: return Compressed::Format::bc4;
+    case Image_Encoding::bc5: return Compressed::Format::bc5;
+    case Image_Encoding::bc6h: return Compressed::Format::bc6h;
+    case Image_Encoding::bc7: return Compressed::Format::bc7;
+    case Image_Encoding::r32f: return Compressed::Format::r32f;
+    case Image_Encoding::rgba32f: return Compressed::Format::rgba32f;
+    case Image_Encoding::r16f: return Compressed::Format::r16f;
+    case Image_Encoding::rgba16f: return Compressed::Format::rgba16f;
+    case Image_Encoding::b10g11r11f: return Compressed::Format::b10g11r11f;
+    case Image_Encoding::e5b9g9r9f: return Compressed::Format::e5b9g9r9f;
+    }
+    RPP_UNREACHABLE;
+}
+
+static u64 encoded_size(Image_Encoding encoding, u32 width, u32 height) {
+    u64 texels = static_cast<u64>(width) * height;
+    u64 blocks = static_cast<u64>((width + 3) / 4) * ((height + 3) / 4);
+    switch(encoding) {
+    case Image_Encoding::r8: return texels;
+    case Image_Encoding::rgba8: return texels * 4;
+    case Image_Encoding::bc1:
+    case Image_Encoding::bc1a:
+    case Image_Encoding::bc4: return blocks * 8;
+    case Image_Encoding::bc2:
+    case Image_Encoding::bc3:
+    case Image_Encoding::bc5:
+    case Image_Encoding::bc6h:
+    case Image_Encoding::bc7: return blocks * 16;
+    case Image_Encoding::r32f: return texels * sizeof(f32);
+    case Image_Encoding::rgba32f: return texels * 4 * sizeof(f32);
+    case Image_Encoding::r16f: return texels * sizeof(u16);
+    case Image_Encoding::rgba16f: return texels * 4 * sizeof(u16);
+    case Image_Encoding::b10g11r11f:
+    case Image_Encoding::e5b9g9r9f: return texels * sizeof(u32);
+    }
+    RPP_UNREACHABLE;
+}
+
+static VkFormat encoded_format(Image_Encoding encoding, bool is_srgb) {
+    switch(encoding) {
+    case Image_Encoding::r8: return is_srgb ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM;
+    case Image_Encoding::rgba8: return is_srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    case Image_Encoding::bc1:
+        return is_srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case Image_Encoding::bc1a:
+        return is_srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case Image_Encoding::bc2: return is_srgb ? VK_FORMAT_BC2_SRGB_BLOCK : VK_FORMAT_BC2_UNORM_BLOCK;
+    case Image_Encoding::bc3: return is_srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case Image_Encoding::bc4: return VK_FORMAT_BC4_UNORM_BLOCK;
+    case Image_Encoding::bc5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case Image_Encoding::bc6h: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case Image_Encoding::bc7: return is_srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    case Image_Encoding::r32f: return VK_FORMAT_R32_SFLOAT;
+    case Image_Encoding::rgba32f: return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case Image_Encoding::r16f: return VK_FORMAT_R16_SFLOAT;
+    case Image_Encoding::rgba16f: return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case Image_Encoding::b10g11r11f: return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+    case Image_Encoding::e5b9g9r9f: return VK_FORMAT_E5B9G9R9_UFLOAT_PACK32;
+    }
+    RPP_UNREACHABLE;
+}
+
+// Picks the encoding of a float image in the requested format. Single channel images use r16f for
+// every compact format. An image the format cannot hold is widened instead of clamped: negative
+// values or alpha need rgba16f, and values past the format's largest need 32 bit floats.
+static Image_Encoding hdr_encoding(HDR_Format format, Slice<const f32> data, u32 channels,
+                                   bool& widened) {
+
+    Image_Encoding wide = channels == 1 ? Image_Encoding::r32f : Image_Encoding::rgba32f;
+    Image_Encoding half = channels == 1 ? Image_Encoding::r16f : Image_Encoding::rgba16f;
+    widened = false;
+    if(format == HDR_Format::rgba32f) return wide;
+
+    Image_Encoding requested = half;
+    f32 largest = Encode::HALF_MAX;
+    if(channels > 1 && format == HDR_Format::b10g11r11) {
+        requested = Image_Encoding::b10g11r11f;
+        largest = Encode::B10_MAX;
+    } else if(channels > 1 && format == HDR_Format::e5b9g9r9) {
+        requested = Image_Encoding::e5b9g9r9f;
+        largest = Encode::RGB9E5_MAX;
+    } else if(channels > 1 && format == HDR_Format::bc6h) {
+        requested = Image_Encoding::bc6h;
+    }
+
+    Encode::HDR_Range range = Encode::hdr_range(data, channels);
+    bool is_signed = range.min < 0.0f || !range.opaque;
+
+    Image_Encoding encoding = requested;
+    if(range.min < -Encode::HALF_MAX || range.max > Encode::HALF_MAX) {
+        encoding = wide;
+    } else if(requested != half && (is_signed || range.max > largest)) {
+        encoding = half;
+    }
+    widened = encoding != requested;
+    return encoding;
+}
+
 struct Image_Buffers {
-    rvk::Buffer staging;
     rvk::Image image;
     rvk::Image_View view;
     Variant<Slice<const u8>, Slice<const f32>> data = Slice<const u8>{};
     u32 width = 0, height = 0, channels = 0;
+    Image_Encoding encoding = Image_Encoding::rgba8;
+    // Precompressed images copy their stored level as is.
+    const Compressed::Image* compressed = null;
 };
 
 #define BIND_STAGING(name, size)                                                                   \
@@ -499,6 +894,303 @@ struct Image_Buffers {
         }                                                                                          \
     }
 
+// Coroutines parked until state guarded by a mutex changes. A waiter only parks if its ready
+// check still fails under the mutex, and every change that may satisfy it is followed by wake,
+// so no wakeup is lost. Waiters resume on the waking thread and should return to the pool
+// before doing real work.
+struct Wait_Queue {
+
+    explicit Wait_Queue(Thread::Mutex& mutex) : mutex(mutex) {
+    }
+
+    template<typename F>
+    struct Awaiter {
+        Wait_Queue& queue;
+        F ready;
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+        [[nodiscard]] bool await_suspend(std::coroutine_handle<> handle) {
+            Thread::Lock lock(queue.mutex);
+            if(ready()) return false;
+            queue.waiting.push(handle);
+            return true;
+        }
+        void await_resume() const noexcept {
+        }
+    };
+
+    // Suspends the caller until the next wake, unless ready returns true. Ready is called with
+    // the mutex held.
+    template<typename F>
+    [[nodiscard]] Awaiter<F> wait(F ready) {
+        return Awaiter<F>{*this, move(ready)};
+    }
+
+    // Resumes every parked waiter. Must be called without the mutex held.
+    void wake() {
+        Vec<std::coroutine_handle<>, Alloc> resume;
+        {
+            Thread::Lock lock(mutex);
+            resume = move(waiting);
+            waiting = Vec<std::coroutine_handle<>, Alloc>{};
+        }
+        for(auto handle : resume) handle.resume();
+    }
+
+private:
+    Thread::Mutex& mutex;
+    Vec<std::coroutine_handle<>, Alloc> waiting;
+};
+
+// Geometry and images stream through a ring of fixed size staging chunks. A chunk returns to the
+// ring once the copies out of it have completed, so large objects never need one contiguous
+// staging allocation and staging memory stays bounded by the size of the ring.
+static constexpr u64 STAGING_CHUNK_SIZE = Math::MB(16);
+
+// Chunks a stream fills before submitting their copies together.
+static constexpr u64 STAGING_STREAM_CHUNKS = 4;
+
+struct Staging_Ring {
+
+    explicit Staging_Ring(u64 size)
+        : max_chunks(Math::max(size / STAGING_CHUNK_SIZE, u64{1})), chunks(max_chunks),
+          in_use(max_chunks) {
+    }
+
+    // Waits for a free chunk, creating one if the ring has not reached its size yet.
+    // Returns nothing only if not even the first chunk fits in the staging heap.
+    Async::Task<Opt<u64>> acquire(Async::Pool<>& pool) {
+        for(;;) {
+            {
+                Thread::Lock lock(mutex);
+                if(auto chunk = take(); chunk.ok()) co_return chunk;
+                if(chunks.length() == 0) co_return Opt<u64>{};
+            }
+            co_await waiters.wait([this] { return available(); });
+            co_await pool.suspend();
+        }
+    }
+
+    // Returns a free chunk if there is one, or if one can be created, without waiting.
+    Opt<u64> try_acquire() {
+        Thread::Lock lock(mutex);
+        return take();
+    }
+
+    void release(u64 chunk) {
+        {
+            Thread::Lock lock(mutex);
+            in_use[chunk] = false;
+            // Other uploads may have freed staging memory since the ring last failed to grow.
+            can_grow = true;
+        }
+        waiters.wake();
+    }
+
+    [[nodiscard]] rvk::Buffer& buffer(u64 chunk) {
+        return chunks[chunk];
+    }
+
+private:
+    // The functions below are called with the mutex held.
+    Opt<u64> take() {
+        for(u64 i = 0; i < chunks.length(); i++) {
+            if(!in_use[i]) {
+                in_use[i] = true;
+                return Opt{i};
+            }
+        }
+        if(chunks.length() < max_chunks && (can_grow || chunks.length() == 0)) {
+            if(auto chunk = rvk::make_staging(STAGING_CHUNK_SIZE); chunk.ok()) {
+                // Capacity was reserved up front, so pushing never moves other chunks.
+                chunks.push(move(*chunk));
+                in_use.push(true);
+                return Opt{chunks.length() - 1};
+            }
+            // Growth is retried once a chunk comes back, rather than shrinking the ring for
+            // the rest of the load.
+            can_grow = false;
+        }
+        return Opt<u64>{};
+    }
+
+    [[nodiscard]] bool available() const {
+        if(chunks.length() < max_chunks && can_grow) return true;
+        for(bool used : in_use) {
+            if(!used) return true;
+        }
+        return false;
+    }
+
+    Thread::Mutex mutex;
+    Wait_Queue waiters{mutex};
+    u64 max_chunks = 0;
+    bool can_grow = true;
+    Vec<rvk::Buffer, Alloc> chunks;
+    Vec<bool, Alloc> in_use;
+};
+
+// Records copies out of ring chunks into buffers and images, submitting them together once the
+// stream holds STAGING_STREAM_CHUNKS full chunks or the ring has no more free.
+struct Staging_Stream {
+
+    Staging_Stream(Async::Pool<>& pool, Staging_Ring& ring) : pool(pool), ring(ring) {
+    }
+    ~Staging_Stream() {
+        release();
+    }
+
+    Staging_Stream(const Staging_Stream&) = delete;
+    Staging_Stream& operator=(const Staging_Stream&) = delete;
+
+    [[nodiscard]] bool failed() const {
+        return failed_;
+    }
+    [[nodiscard]] u64 available() const {
+        return STAGING_CHUNK_SIZE - used;
+    }
+
+    // Returns size contiguous bytes of staging memory that will be copied to dst at offset.
+    // Size must not exceed STAGING_CHUNK_SIZE.
+    Async::Task<u8*> reserve(rvk::Buffer& dst, u64 offset, u64 size) {
+        if(!co_await make_room(size)) co_return null;
+
+        u64 chunk = held[held.length() - 1];
+        copies.push(Copy{chunk, &dst,
+                         VkBufferCopy{.srcOffset = used, .dstOffset = offset, .size = size}});
+        u8* map = ring.buffer(chunk).map() + used;
+        used += size;
+        co_return map;
+    }
+
+    // Returns size contiguous bytes of staging memory that will be copied to the region of dst.
+    // The image must be in TRANSFER_DST_OPTIMAL when the copies are submitted; see discard.
+    // Offsets are aligned for every texel and block format.
+    Async::Task<u8*> reserve(rvk::Image& dst, VkBufferImageCopy region, u64 size) {
+        if(!co_await make_room(size, 16)) co_return null;
+
+        u64 chunk = held[held.length() - 1];
+        region.bufferOffset = used;
+        image_copies.push(Image_Copy{chunk, &dst, region});
+        u8* map = ring.buffer(chunk).map() + used;
+        used += size;
+        co_return map;
+    }
+
+    // Moves dst from UNDEFINED to TRANSFER_DST_OPTIMAL ahead of the next submitted copies.
+    void discard(rvk::Image& dst) {
+        discards.push(&dst);
+    }
+
+    // Copies src to dst at offset, split across as many chunks as necessary.
+    Async::Task<void> write(rvk::Buffer& dst, u64 offset, Slice<const u8> src) {
+        u64 done = 0;
+        while(done < src.length() && !failed_) {
+            if(available() == 0) co_await advance();
+            u64 size = Math::min(src.length() - done, available());
+            if(u8* map = co_await reserve(dst, offset + done, size)) {
+                Libc::memcpy(map, src.data() + done, size);
+            }
+            done += size;
+        }
+    }
+
+    // Moves on to an empty chunk. Takes another free chunk from the ring without waiting while
+    // the stream holds fewer than STAGING_STREAM_CHUNKS, and otherwise submits the pending
+    // copies first. A stream holding chunks never waits on the ring, so streams cannot
+    // deadlock each other.
+    Async::Task<void> advance() {
+        if(!held.length()) co_return;
+        if(held.length() < STAGING_STREAM_CHUNKS) {
+            if(auto chunk = ring.try_acquire(); chunk.ok()) {
+                held.push(*chunk);
+                used = 0;
+                co_return;
+            }
+        }
+        co_await flush();
+    }
+
+    // Submits the pending copies followed by the commands recorded by f, then waits for the
+    // copies to complete and returns the chunks. Nothing is submitted once the stream has failed.
+    template<typename F>
+    Async::Task<void> finish(F f) {
+        if(!failed_) {
+            co_await rvk::async(pool, [&](rvk::Commands& cmds) {
+                for(auto* image : discards) {
+                    image->transition(cmds, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
+                                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                      VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
+                                      VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_NONE,
+                                      VK_ACCESS_2_TRANSFER_WRITE_BIT);
+                }
+                for(auto& copy : copies) {
+                    vkCmdCopyBuffer(cmds, ring.buffer(copy.chunk), *copy.dst, 1, &copy.region);
+                }
+                for(auto& copy : image_copies) {
+                    vkCmdCopyBufferToImage(cmds, ring.buffer(copy.chunk), *copy.dst,
+                                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+                }
+                f(cmds);
+            });
+        }
+        release();
+    }
+
+    Async::Task<void> flush() {
+        co_await finish([](rvk::Commands&) {});
+    }
+
+private:
+    // Moves on to a chunk with size bytes free at the given alignment. Returns false once the
+    // stream has failed.
+    Async::Task<bool> make_room(u64 size, u64 alignment = 1) {
+        if(held.length() && Math::align_pow2(used, alignment) + size > STAGING_CHUNK_SIZE) {
+            co_await advance();
+        }
+        if(!held.length() && !failed_) {
+            if(auto chunk = co_await ring.acquire(pool); chunk.ok()) {
+                held.push(*chunk);
+            } else {
+                failed_ = true;
+            }
+        }
+        used = Math::align_pow2(used, alignment);
+        co_return !failed_;
+    }
+
+    struct Copy {
+        u64 chunk = 0;
+        rvk::Buffer* dst = null;
+        VkBufferCopy region = {};
+    };
+    struct Image_Copy {
+        u64 chunk = 0;
+        rvk::Image* dst = null;
+        VkBufferImageCopy region = {};
+    };
+
+    void release() {
+        for(u64 chunk : held) ring.release(chunk);
+        held.clear();
+        copies.clear();
+        image_copies.clear();
+        discards.clear();
+        used = 0;
+    }
+
+    Async::Pool<>& pool;
+    Staging_Ring& ring;
+    Vec<u64, Alloc> held;
+    Vec<Copy, Alloc> copies;
+    Vec<Image_Copy, Alloc> image_copies;
+    Vec<rvk::Image*, Alloc> discards;
+    u64 used = 0;
+    bool failed_ = false;
+};
+
 template<typename Material>
 static Result<Materials_Buffers<Material>>
 allocate_materials(Slice<const Material> materials, Slice<const u64> texture_to_image_index,
@@ -513,12 +1205,19 @@ allocate_materials(Slice<const Material> materials, Slice<const u64> texture_to_
                              texture_to_sampler_index};
 }
 
+static Shadowed_Upload upload_shadowed(rvk::Commands& cmds, rvk::Buffer staging,
+                                       rvk::Buffer device, u64 size) {
+    VkBufferCopy region = {.srcOffset = 0, .dstOffset = 0, .size = size};
+    vkCmdCopyBuffer(cmds, staging, device, 1, &region);
+    return Shadowed_Upload{move(device), move(staging)};
+}
+
 template<typename Scene>
-static rvk::Buffer write_materials(
+static Shadowed_Upload write_materials(
     rvk::Commands& cmds, const Scene& cpu,
     Materials_Buffers<If<Same<Scene, PBRT::Scene>, PBRT::Material, GLTF::Material>> buffers) {
 
-    if(buffers.materials.length() == 0) return rvk::Buffer{};
+    if(buffers.materials.length() == 0) return Shadowed_Upload{};
 
     GPU_Material* map = reinterpret_cast<GPU_Material*>(buffers.staging.map());
     u64 offset = 0;
@@ -530,7 +1229,9 @@ static rvk::Buffer write_materials(
         }
     } else {
         auto remap = [&](i32 id, bool has_const) {
-            if(id == -1) return has_const ? GPU_Texture_ID::constant() : GPU_Texture_ID{};
+            if(id == -1 || static_cast<u64>(id) >= buffers.texture_to_image_index.length()) {
+                return has_const ? GPU_Texture_ID::constant() : GPU_Texture_ID{};
+            }
             u64 idx = buffers.texture_to_image_index[id];
             u64 sampler_idx = buffers.texture_to_sampler_index[id];
             return idx >= MAX_IMAGES || sampler_idx >= MAX_SAMPLERS
@@ -552,12 +1253,12 @@ static rvk::Buffer write_materials(
         }
     }
 
-    buffers.device.move_from(cmds, move(buffers.staging));
-    return move(buffers.device);
+    return upload_shadowed(cmds, move(buffers.staging), move(buffers.device),
+                           offset * sizeof(GPU_Material));
 }
 
 template<typename Scene>
-static Async::Task<rvk::Buffer> write_materials_async(
+static Async::Task<Shadowed_Upload> write_materials_async(
     Async::Pool<>& pool, const Scene& cpu,
     Materials_Buffers<If<Same<Scene, PBRT::Scene>, PBRT::Material, GLTF::Material>> buffers) {
     co_await pool.suspend();
@@ -577,11 +1278,11 @@ static Result<Lights_Buffers<Light>> allocate_lights(Slice<const Pair<Mat4, u32>
 }
 
 template<typename Scene>
-static rvk::Buffer
+static Shadowed_Upload
 write_lights(rvk::Commands& cmds, const Scene& cpu,
              Lights_Buffers<If<Same<Scene, PBRT::Scene>, PBRT::Light, GLTF::Light>> buffers) {
 
-    if(buffers.lights.length() == 0) return rvk::Buffer{};
+    if(buffers.lights.length() == 0) return Shadowed_Upload{};
 
     GPU_Delta_Light* map = reinterpret_cast<GPU_Delta_Light*>(buffers.staging.map());
     u64 offset = 0;
@@ -630,12 +1331,12 @@ write_lights(rvk::Commands& cmds, const Scene& cpu,
         }
     }
 
-    buffers.device.move_from(cmds, move(buffers.staging));
-    return move(buffers.device);
+    return upload_shadowed(cmds, move(buffers.staging), move(buffers.device),
+                           offset * sizeof(GPU_Delta_Light));
 }
 
 template<typename Scene>
-static Async::Task<rvk::Buffer>
+static Async::Task<Shadowed_Upload>
 write_lights_async(Async::Pool<>& pool, const Scene& cpu,
                    Lights_Buffers<If<Same<Scene, PBRT::Scene>, PBRT::Light, GLTF::Light>> buffers) {
     co_await pool.suspend();
@@ -643,38 +1344,93 @@ write_lights_async(Async::Pool<>& pool, const Scene& cpu,
         pool, [&](rvk::Commands& cmds) { return write_lights<Scene>(cmds, cpu, move(buffers)); });
 }
 
+static u64 geometry_size(const Mesh_Ref& mesh) {
+
+    if(!mesh.check()) return 0;
+
+    u64 normals_size = (mesh.normals.length() / 3) * sizeof(u16) * 2;
+    u64 tangents_size = normals_size ? (mesh.tangents.length() / 3) * sizeof(u16) : 0;
+    u64 uvs_size = (mesh.uvs.length() / 2) * sizeof(u16) * 2;
+
+    if(!normals_size && !uvs_size && !tangents_size) return 0;
+
+    u64 size = Math::align(normals_size + uvs_size + tangents_size, 16);
+    return Math::align(size + mesh.index_bytes(), 16);
+}
+
 static Result<Geometry_Buffers> allocate_geometry(Slice<const Mesh_Ref> meshes) {
 
     u64 size = 0;
     for(auto& mesh : meshes) {
+        size += geometry_size(mesh);
+    }
 
-        if(!mesh.check()) continue;
+    if(size == 0) return Geometry_Buffers{rvk::Buffer{}, meshes};
+
+    BIND_DEVICE(device, size,
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    return Geometry_Buffers{move(device), meshes};
+}
 
-        u64 normals_size = (mesh.normals.length() / 3) * sizeof(u16) * 2;
-        u64 tangents_size = normals_size ? (mesh.tangents.length() / 3) * sizeof(u16) : 0;
-        u64 uvs_size = (mesh.uvs.length() / 2) * sizeof(u16) * 2;
+template<typename T>
+static Slice<const T> sub_slice(Slice<const T> slice, u64 begin, u64 length) {
+    if(slice.empty()) return slice;
+    return Slice<const T>{slice.data() + begin, length};
+}
 
-        if(normals_size || uvs_size || tangents_size) {
-            size += normals_size + uvs_size + tangents_size;
-            size = Math::align(size, 16);
-            size += mesh.indices.bytes();
-            size = Math::align(size, 16);
+// Encodes count elements of stride bytes each into chunk sized ranges of staging memory.
+// encode(map, begin, n) writes elements [begin, begin + n) to map.
+template<typename F>
+static Async::Task<void> stage_encoded(Staging_Stream& stream, rvk::Buffer& device, u64 offset,
+                                       u64 count, u64 stride, F encode) {
+    for(u64 i = 0; i < count && !stream.failed();) {
+        if(stream.available() < stride) co_await stream.advance();
+        u64 n = Math::min(count - i, stream.available() / stride);
+        if(u8* map = co_await stream.reserve(device, offset + i * stride, n * stride)) {
+            encode(map, i, n);
         }
+        i += n;
     }
+}
 
-    if(size == 0) return Geometry_Buffers{rvk::Buffer{}, rvk::Buffer{}, meshes};
+static Async::Task<u64> stage_vertices(Staging_Stream& stream, rvk::Buffer& device, u64 offset,
+                                       const Mesh_Ref& mesh) {
 
-    BIND_STAGING(staging, size);
-    BIND_DEVICE(device, size,
-                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-    return Geometry_Buffers{move(staging), move(device), meshes};
+    u64 stride = (mesh.normals.length() ? sizeof(u32) : 0) +
+                 (mesh.normals.length() && mesh.tangents.length() ? sizeof(u16) : 0) +
+                 (mesh.uvs.length() ? sizeof(u32) : 0);
+    if(stride == 0) co_return 0;
+
+    u64 vertices = mesh.normals.length() ? mesh.normals.length() / 3 : mesh.uvs.length() / 2;
+
+    co_await stage_encoded(stream, device, offset, vertices, stride,
+                           [&](u8* map, u64 v, u64 n) {
+                               Encode::mesh(map, sub_slice(mesh.uvs, v * 2, n * 2),
+                                            sub_slice(mesh.normals, v * 3, n * 3),
+                                            sub_slice(mesh.tangents, v * 3, n * 3));
+                           });
+    co_return vertices * stride;
+}
+
+static Async::Task<void> stage_indices(Staging_Stream& stream, rvk::Buffer& device, u64 offset,
+                                       const Mesh_Ref& mesh) {
+    if(!mesh.index16()) {
+        co_await stream.write(device, offset, mesh.indices.to_bytes());
+        co_return;
+    }
+    co_await stage_encoded(stream, device, offset, mesh.indices.length(), sizeof(u16),
+                           [&](u8* map, u64 i, u64 n) {
+                               Encode::indices16(map, sub_slice(mesh.indices, i, n));
+                           });
 }
 
-static Geometry_Result write_geometry(rvk::Commands& cmds, Geometry_Buffers buffers) {
+static Async::Task<Geometry_Result> write_geometry_async(Async::Pool<>& pool, Staging_Ring& ring,
+                                                         Geometry_Buffers buffers) {
+    co_await pool.suspend();
 
-    if(buffers.meshes.empty()) return Geometry_Result{};
+    if(buffers.meshes.empty()) co_return Geometry_Result{};
 
-    u8* map = buffers.staging.map();
+    Staging_Stream stream{pool, ring};
     u64 offset = 0;
     u64 device_addr = buffers.device.gpu_address();
 
@@ -688,6 +1444,7 @@ static Geometry_Result write_geometry(rvk::Commands& cmds, Geometry_Buffers buff
         flags.flip_bt = mesh.flags.flip_bt;
         flags.double_sided = mesh.flags.double_sided;
         flags.flip_v = mesh.flags.flip_v;
+        flags.index16 = mesh.index16();
 
         if(!mesh.check()) {
             out.push(CPU_Geometry_Reference{
@@ -704,7 +1461,7 @@ static Geometry_Result write_geometry(rvk::Commands& cmds, Geometry_Buffers buff
         }
 
         u64 v_start = offset;
-        u64 v_size = Encode::mesh(map + offset, mesh.uvs, mesh.normals, mesh.tangents);
+        u64 v_size = co_await stage_vertices(stream, buffers.device, offset, mesh);
         offset += v_size;
 
         offset = Math::align(offset, 16);
@@ -712,8 +1469,8 @@ static Geometry_Result write_geometry(rvk::Commands& cmds, Geometry_Buffers buff
         u64 i_start = offset;
         u64 i_size = 0;
         if(v_size) {
-            Libc::memcpy(map + offset, mesh.indices.data(), mesh.indices.bytes());
-            i_size = mesh.indices.bytes();
+            co_await stage_indices(stream, buffers.device, offset, mesh);
+            i_size = mesh.index_bytes();
             offset += i_size;
         }
 
@@ -731,15 +1488,13 @@ static Geometry_Result write_geometry(rvk::Commands& cmds, Geometry_Buffers buff
         });
     }
 
-    if(buffers.staging) buffers.device.move_from(cmds, move(buffers.staging));
-    return Geometry_Result{move(buffers.device), move(out)};
-}
+    co_await stream.finish([](rvk::Commands&) {});
 
-static Async::Task<Geometry_Result> write_geometry_async(Async::Pool<>& pool,
-                                                         Geometry_Buffers buffers) {
-    co_await pool.suspend();
-    co_return co_await rvk::async(
-        pool, [&](rvk::Commands& cmds) { return write_geometry(cmds, move(buffers)); });
+    if(stream.failed()) {
+        warn("Geometry too large for staging heap.");
+        co_return Geometry_Result{};
+    }
+    co_return Geometry_Result{move(buffers.device), move(out)};
 }
 
 static Result<Geometry_Reference_Buffers>
@@ -771,7 +1526,7 @@ static rvk::Buffer write_geometry_references(rvk::Commands& cmds,
         GPU_Texture_ID gpu_alpha_texture_id;
         u32 alpha_texture_id = buffers.geometry[i].alpha_texture_id;
 
-        if(alpha_texture_id != RPP_UINT32_MAX) {
+        if(alpha_texture_id < buffers.texture_to_image_index.length()) {
             u64 idx = buffers.texture_to_image_index[alpha_texture_id];
             u64 sampler_idx = buffers.texture_to_sampler_index[alpha_texture_id];
             gpu_alpha_texture_id = idx >= MAX_IMAGES || sampler_idx >= MAX_SAMPLERS
@@ -807,8 +1562,8 @@ template<typename Texture>
 rvk::Sampler::Config sampler_config(const Texture& texture) {
     rvk::Sampler::Config sampler;
     if constexpr(Same<Texture, PBRT::Textures::Texture>) {
-        sampler.mag = sampler.min =
-            texture.filter == PBRT::Textures::Filter::point ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+        bool point = texture.filter == PBRT::Textures::Filter::point;
+        sampler.mag = sampler.min = point ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
         sampler.u = sampler.v = sampler.w =
             texture.wrap == PBRT::Textures::Wrap::repeat  ? VK_SAMPLER_ADDRESS_MODE_REPEAT
             : texture.wrap == PBRT::Textures::Wrap::clamp ? VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
@@ -820,22 +1575,24 @@ rvk::Sampler::Config sampler_config(const Texture& texture) {
     return sampler;
 }
 
-static Result<Image_Buffers> allocate_envmap(const PBRT::Lights::Light& light) {
+static Result<Image_Buffers> allocate_envmap(const PBRT::Lights::Light& light,
+                                             HDR_Format hdr_format) {
 
     if(light.type != PBRT::Lights::Type::infinite) return Image_Buffers{};
 
     u32 width = light.map.w;
     u32 height = light.map.h;
     u32 src_channels = light.map.channels;
-    u32 dst_channels = src_channels == 1 ? 1 : 4;
-
-    u64 staging_size = width * height * dst_channels * sizeof(f32);
-
-    if(staging_size == 0) return Image_Buffers{};
 
-    BIND_STAGING(staging, staging_size);
+    if(static_cast<u64>(width) * height == 0) return Image_Buffers{};
 
-    VkFormat format = dst_channels == 1 ? VK_FORMAT_R32_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
+    bool widened = false;
+    Image_Encoding encoding =
+        hdr_encoding(hdr_format, light.map.data.slice(), src_channels, widened);
+    if(widened) {
+        warn("Envmap values do not fit %; uploading it in a wider format.", hdr_format);
+    }
+    VkFormat format = encoded_format(encoding, false);
 
     auto image = rvk::make_image(VkExtent3D{.width = width, .height = height, .depth = 1}, format,
                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
@@ -843,70 +1600,223 @@ static Result<Image_Buffers> allocate_envmap(const PBRT::Lights::Light& light) {
 
     rvk::Image_View view = image->view(VK_IMAGE_ASPECT_COLOR_BIT);
 
-    return Image_Buffers{move(staging), move(*image), move(view),  light.map.data.slice(),
-                         width,         height,       src_channels};
+    return Image_Buffers{move(*image),  move(view), light.map.data.slice(), width, height,
+                         src_channels, encoding};
 }
 
-template<typename Texture>
-static Result<Image_Buffers> allocate_image(const Texture& texture) {
-
-    bool is_srgb;
-    Variant<Slice<const u8>, Slice<const f32>> pixel_data = Slice<const u8>{};
-    u32 width, height, src_channels;
+// Extent of an image dimension after halving it reduction times.
+static u32 reduced_extent(u32 extent, u32 reduction) {
+    return Math::max(reduction < 32 ? extent >> reduction : 0u, 1u);
+}
 
-    if constexpr(Same<Texture, PBRT::Textures::Texture>) {
-        texture.image.match(Overload{
-            [&](const PBRT::Image_Data<u8>& data) {
-                pixel_data = data.data.slice();
-                src_channels = data.channels;
-                width = data.w;
-                height = data.h;
-            },
-            [&](const PBRT::Image_Data<f32>& data) {
-                pixel_data = data.data.slice();
-                src_channels = data.channels;
-                width = data.w;
-                height = data.h;
-            },
-        });
-        is_srgb = texture.encoding == PBRT::Textures::Encoding::sRGB;
-    } else {
-        pixel_data = texture.data.slice();
-        src_channels = texture.components;
-        width = texture.width;
-        height = texture.height;
-        is_srgb = true;
-    }
-    if(src_channels < 1 || src_channels > 4) {
-        warn("Image texture has bad channels (%).", src_channels);
-        return Image_Buffers{};
+struct Image_Source {
+    Variant<Slice<const u8>, Slice<const f32>> data = Slice<const u8>{};
+    u32 width = 0, height = 0, channels = 0;
+    bool is_srgb = true;
+    bool compress = false;
+    // Encoding of float data, and whether it is wider than the requested HDR format.
+    Image_Encoding hdr = Image_Encoding::rgba32f;
+    bool hdr_widened = false;
+    // Precompressed images are reduced by skipping their largest levels.
+    const Compressed::Image* compressed = null;
+    u32 base_level = 0;
+
+    [[nodiscard]] Image_Source clone() const {
+        Image_Source ret{Slice<const u8>{}, width, height, channels, is_srgb,
+                         compress, hdr, hdr_widened, compressed, base_level};
+        data.match([&](const auto& slice) { ret.data = slice; });
+        return ret;
+    }
+    [[nodiscard]] bool empty() const {
+        if(compressed) return compressed->levels() == 0;
+        return data.match([](const auto& data) { return data.empty(); });
+    }
+    [[nodiscard]] bool reducible() const {
+        if(compressed) return base_level + 1 < compressed->levels();
+        return width > 1 || height > 1;
+    }
+    [[nodiscard]] u32 first_level(u32 reduction) const {
+        return Math::min(base_level + reduction, compressed->levels() - 1);
+    }
+    [[nodiscard]] bool is_hdr() const {
+        return data.match(Overload{
+            [](const Slice<const u8>&) { return false; },
+            [](const Slice<const f32>&) { return true; },
+        });
     }
+    // 8 bit images are block compressed by channel count. BC4 and BC5 have no sRGB formats, so
+    // one and two channel sRGB images keep their texels.
+    [[nodiscard]] Image_Encoding encoding() const {
+        if(compressed) return precompressed_encoding(compressed->format);
+        if(is_hdr()) return hdr;
+        if(compress && channels == 3) return Image_Encoding::bc1;
+        if(compress && channels == 4) return Image_Encoding::bc3;
+        if(compress && !is_srgb && channels == 1) return Image_Encoding::bc4;
+        if(compress && !is_srgb && channels == 2) return Image_Encoding::bc5;
+        return channels == 1 ? Image_Encoding::r8 : Image_Encoding::rgba8;
+    }
+    [[nodiscard]] u64 staging_size(u32 reduction = 0) const {
+        if(channels < 1 || channels > 4 || empty()) return 0;
+        if(compressed) return compressed->level(first_level(reduction)).length();
+        return encoded_size(encoding(), reduced_extent(width, reduction),
+                            reduced_extent(height, reduction));
+    }
+};
+
+template<typename Texture>
+static Image_Source image_source(const Texture& texture, bool compress, HDR_Format hdr_format) {
+
+    Image_Source source;
+    source.compress = compress;
 
-    bool no_data = pixel_data.match([](const auto& data) { return data.empty(); });
-    bool is_hdr = pixel_data.match(Overload{
-        [](const Slice<const u8>&) { return false; },
-        [](const Slice<const f32>&) { return true; },
+    if constexpr(Same<Texture, PBRT::Textures::Texture>) {
+        texture.image.match(Overload{
+            [&](const PBRT::Image_Data<u8>& data) {
+                source.data = data.data.slice();
+                source.channels = data.channels;
+                source.width = data.w;
+                source.height = data.h;
+            },
+            [&](const PBRT::Image_Data<f32>& data) {
+                source.data = data.data.slice();
+                source.channels = data.channels;
+                source.width = data.w;
+                source.height = data.h;
+            },
+            [&](const Compressed::Image& image) {
+                source.compressed = &image;
+                source.channels = 4;
+                source.width = image.w;
+                source.height = image.h;
+            },
+        });
+        source.is_srgb = texture.encoding == PBRT::Textures::Encoding::sRGB;
+    } else {
+        if(!texture.compressed.data.empty()) {
+            source.compressed = &texture.compressed;
+        } else {
+            source.data = texture.data.slice();
+        }
+        source.channels = texture.components;
+        source.width = texture.width;
+        source.height = texture.height;
+        source.is_srgb = true;
+    }
+    if(source.compressed && source.compressed->srgb_known) {
+        source.is_srgb = source.compressed->srgb;
+    }
+    source.data.match(Overload{
+        [](const Slice<const u8>&) {},
+        [&](const Slice<const f32>& data) {
+            source.hdr = hdr_encoding(hdr_format, data, source.channels, source.hdr_widened);
+        },
     });
+    return source;
+}
+
+// Replaces image data with its box filtered half, keeping the new texels in storage.
+static void halve_image(Variant<Slice<const u8>, Slice<const f32>>& data, u32& width,
+                        u32& height, u32 channels, Vec<u8, Alloc>& ldr_storage,
+                        Vec<f32, Alloc>& hdr_storage) {
 
-    u32 dst_channels = src_channels == 1 ? 1 : 4;
-    u64 staging_size = width * height * dst_channels * (is_hdr ? sizeof(f32) : sizeof(u8));
+    u64 length = static_cast<u64>(reduced_extent(width, 1)) * reduced_extent(height, 1) * channels;
 
-    if(staging_size == 0 || no_data) return Image_Buffers{};
+    bool is_hdr = data.match(Overload{
+        [&](const Slice<const u8>& src) {
+            Vec<u8, Alloc> next;
+            next.resize(length);
+            Encode::halve8(next.data(), src, width, height, channels);
+            ldr_storage = move(next);
+            return false;
+        },
+        [&](const Slice<const f32>& src) {
+            Vec<f32, Alloc> next;
+            next.resize(length);
+            Encode::halve32f(next.data(), src, width, height, channels);
+            hdr_storage = move(next);
+            return true;
+        },
+    });
 
-    VkFormat format = {};
-    if(is_hdr && dst_channels == 1) {
-        format = VK_FORMAT_R32_SFLOAT;
-    } else if(is_hdr && dst_channels == 4) {
-        format = VK_FORMAT_R32G32B32A32_SFLOAT;
-    } else if(dst_channels == 1) {
-        format = is_srgb ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8_UNORM;
-    } else if(dst_channels == 4) {
-        format = is_srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    if(is_hdr) {
+        Slice<const f32> hdr = hdr_storage.slice();
+        data = hdr;
     } else {
-        RPP_UNREACHABLE;
+        Slice<const u8> ldr = ldr_storage.slice();
+        data = ldr;
+    }
+    width = reduced_extent(width, 1);
+    height = reduced_extent(height, 1);
+}
+
+// Halves the source reduction times. An image reduced to a single texel holds its average;
+// precompressed images stop at their smallest stored level.
+static void reduce_image(Image_Source& source, u32 reduction, Vec<u8, Alloc>& ldr_storage,
+                         Vec<f32, Alloc>& hdr_storage) {
+    for(u32 i = 0; i < reduction && source.reducible(); i++) {
+        if(source.compressed) {
+            source.base_level++;
+            source.width = reduced_extent(source.compressed->w, source.base_level);
+            source.height = reduced_extent(source.compressed->h, source.base_level);
+        } else {
+            halve_image(source.data, source.width, source.height, source.channels, ldr_storage,
+                        hdr_storage);
+        }
+    }
+}
+
+// Describes every texture once, so float images are scanned for their encoding only once per
+// load.
+template<typename Texture>
+static Vec<Image_Source, Alloc> image_sources(Slice<const Texture> textures, bool compress,
+                                              HDR_Format hdr_format) {
+    Vec<Image_Source, Alloc> sources(textures.length());
+    for(auto& texture : textures) {
+        sources.push(image_source(texture, compress, hdr_format));
+    }
+    return sources;
+}
+
+// Picks how many times to halve each image so that all of them fit in the texture budget. Every
+// image is clamped to the largest power of two extent for which the total fits, so the largest
+// images lose detail first.
+static Vec<u32, Alloc> plan_reductions(Slice<const Image_Source> sources, u64 budget) {
+
+    Vec<u32, Alloc> reductions(sources.length());
+    u64 total = 0;
+    for(auto& source : sources) {
+        reductions.push(0);
+        total += source.staging_size();
+    }
+    if(total <= budget) return reductions;
+
+    for(u32 max_extent = 1u << 15; max_extent >= 1; max_extent /= 2) {
+        total = 0;
+        for(u64 i = 0; i < sources.length(); i++) {
+            u32 extent = Math::max(sources[i].width, sources[i].height);
+            u32 reduction = 0;
+            while(reduced_extent(extent, reduction) > max_extent) reduction++;
+            reductions[i] = reduction;
+            total += sources[i].staging_size(reduction);
+        }
+        if(total <= budget) break;
+    }
+    return reductions;
+}
+
+static Result<Image_Buffers> allocate_image(const Image_Source& source) {
+
+    if(source.channels < 1 || source.channels > 4) {
+        warn("Image texture has bad channels (%).", source.channels);
+        return Image_Buffers{};
     }
 
-    BIND_STAGING(staging, staging_size);
+    u64 staging_size = source.staging_size();
+    if(staging_size == 0) return Image_Buffers{};
+
+    u32 width = source.width, height = source.height;
+    Image_Encoding encoding = source.encoding();
+    VkFormat format = encoded_format(encoding, source.is_srgb);
 
     auto image = rvk::make_image(VkExtent3D{.width = width, .height = height, .depth = 1}, format,
                                  VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
@@ -916,140 +1826,314 @@ static Result<Image_Buffers> allocate_image(const Texture& texture) {
 
     rvk::Image_View view = image->view(VK_IMAGE_ASPECT_COLOR_BIT);
 
-    return Image_Buffers{move(staging), move(*image), move(view),  move(pixel_data),
-                         width,         height,       src_channels};
+    Variant<Slice<const u8>, Slice<const f32>> data = Slice<const u8>{};
+    if(source.compressed) {
+        Slice<const u8> blocks = source.compressed->level(source.base_level);
+        data = blocks;
+    } else {
+        source.data.match([&](const auto& slice) { data = slice; });
+    }
+
+    return Image_Buffers{move(*image), move(view),      move(data), width,
+                         height,       source.channels, encoding,   source.compressed};
+}
+
+static void write_image_rows(u8* map, const Image_Buffers& buffers, u32 row, u32 rows) {
+
+    u64 begin = static_cast<u64>(row) * buffers.width * buffers.channels;
+    u64 length = static_cast<u64>(rows) * buffers.width * buffers.channels;
+
+    buffers.data.match(Overload{
+        [&](const Slice<const f32>& data) {
+            auto src = sub_slice(data, begin, length);
+            if(buffers.encoding == Image_Encoding::r16f) {
+                Encode::r16f(map, src, buffers.width, rows);
+            } else if(buffers.encoding == Image_Encoding::rgba16f) {
+                Encode::rgba16f(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.encoding == Image_Encoding::b10g11r11f) {
+                Encode::b10g11r11f(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.encoding == Image_Encoding::e5b9g9r9f) {
+                Encode::e5b9g9r9f(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.encoding == Image_Encoding::bc6h) {
+                Encode::bc6h(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.channels == 2) {
+                Encode::rg32f_to_rgba32f(map, src, buffers.width, rows);
+            } else if(buffers.channels == 3) {
+                Encode::rgb32f_to_rgba32f(map, src, buffers.width, rows);
+            } else {
+                Libc::memcpy(map, src.data(), src.bytes());
+            }
+        },
+        [&](const Slice<const u8>& data) {
+            if(buffers.compressed) {
+                // Precompressed levels are already rows of blocks or texels.
+                u32 block = is_block_compressed(buffers.encoding) ? 4 : 1;
+                u64 row_size = encoded_size(buffers.encoding, buffers.width, 1);
+                auto blocks = sub_slice(data, row / block * row_size,
+                                        (rows + block - 1) / block * row_size);
+                Libc::memcpy(map, blocks.data(), blocks.bytes());
+                return;
+            }
+            auto src = sub_slice(data, begin, length);
+            if(buffers.encoding == Image_Encoding::bc1) {
+                Encode::bc1(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.encoding == Image_Encoding::bc3) {
+                Encode::bc3(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.encoding == Image_Encoding::bc4) {
+                Encode::bc4(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.encoding == Image_Encoding::bc5) {
+                Encode::bc5(map, src, buffers.width, rows, buffers.channels);
+            } else if(buffers.channels == 2) {
+                Encode::rg8_to_rgba8(map, src, buffers.width, rows);
+            } else if(buffers.channels == 3) {
+                Encode::rgb8_to_rgba8(map, src, buffers.width, rows);
+            } else {
+                Libc::memcpy(map, src.data(), src.bytes());
+            }
+        },
+    });
+}
+
+// Number of levels in a full mip chain down to a single texel.
+static u32 mip_levels(u32 width, u32 height) {
+    u32 levels = 1;
+    while(reduced_extent(width, levels - 1) > 1 || reduced_extent(height, levels - 1) > 1) {
+        levels++;
+    }
+    return levels;
 }
 
-static GPU_Image write_image(rvk::Commands& cmds, Image_Buffers buffers) {
+// Encodes a decoded image the way write_image_async does, for the texture cache. Only the first
+// level is uploaded; the rest of the chain lets later reductions skip to a smaller stored level.
+static Compressed::Image encode_image(const Image_Source& source) {
+
+    Image_Buffers level;
+    source.data.match([&](const auto& slice) { level.data = slice; });
+    level.width = source.width;
+    level.height = source.height;
+    level.channels = source.channels;
+    level.encoding = source.encoding();
+
+    Compressed::Image image;
+    image.w = source.width;
+    image.h = source.height;
+    image.format = cached_format(level.encoding);
+    image.srgb = source.is_srgb;
+
+    u32 levels = mip_levels(source.width, source.height);
+    u64 total = 0;
+    for(u32 i = 0; i < levels; i++) {
+        image.offsets.push(total);
+        total += encoded_size(level.encoding, reduced_extent(source.width, i),
+                              reduced_extent(source.height, i));
+    }
+    image.offsets.push(total);
+    image.data.resize(total);
+
+    Vec<u8, Alloc> ldr_level;
+    Vec<f32, Alloc> hdr_level;
+    for(u32 i = 0; i < levels; i++) {
+        if(i > 0) {
+            halve_image(level.data, level.width, level.height, level.channels, ldr_level,
+                        hdr_level);
+        }
+        write_image_rows(image.data.data() + image.offsets[i], level, 0, level.height);
+    }
+    return image;
+}
 
-    if(buffers.data.match([](const auto& data) { return data.empty(); })) return GPU_Image{};
+// Images are copied in bands of rows that each fit in one staging chunk. The bands stream like
+// geometry, so several chunks of rows are submitted together.
+static Async::Task<GPU_Image> write_image_async(Async::Pool<>& pool, Staging_Ring& ring,
+                                               Image_Buffers buffers) {
+    co_await pool.suspend();
 
-    if(buffers.channels == 1 || buffers.channels == 4) {
-        buffers.staging.write(buffers.data.match([](const auto& data) { return data.to_bytes(); }));
-    } else if(buffers.channels == 2) {
-        buffers.data.match(Overload{
-            [&](const Slice<const f32>& data) {
-                Encode::rg32f_to_rgba32f(buffers.staging.map(), data, buffers.width,
-                                         buffers.height);
-            },
-            [&](const Slice<const u8>& data) {
-                Encode::rg8_to_rgba8(buffers.staging.map(), data, buffers.width, buffers.height);
-            },
-        });
-    } else if(buffers.channels == 3) {
-        buffers.data.match(Overload{
-            [&](const Slice<const f32>& data) {
-                Encode::rgb32f_to_rgba32f(buffers.staging.map(), data, buffers.width,
-                                          buffers.height);
-            },
-            [&](const Slice<const u8>& data) {
-                Encode::rgb8_to_rgba8(buffers.staging.map(), data, buffers.width, buffers.height);
-            },
-        });
+    if(buffers.data.match([](const auto& data) { return data.empty(); })) co_return GPU_Image{};
+
+    // Block compressed images are copied in rows of blocks, each covering four rows of texels.
+    u32 block_rows = is_block_compressed(buffers.encoding) ? 4 : 1;
+    u64 row_size = encoded_size(buffers.encoding, buffers.width, 1);
+    if(row_size > STAGING_CHUNK_SIZE) {
+        warn("Image rows too large for staging chunks.");
+        co_return GPU_Image{};
+    }
+    u32 band = static_cast<u32>(STAGING_CHUNK_SIZE / row_size) * block_rows;
+
+    Staging_Stream stream{pool, ring};
+    stream.discard(buffers.image);
+
+    for(u32 row = 0; row < buffers.height; row += band) {
+        u32 rows = Math::min(band, buffers.height - row);
+        u64 size = (rows + block_rows - 1) / block_rows * row_size;
+
+        VkBufferImageCopy region = {
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource =
+                {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            .imageOffset = {.x = 0, .y = static_cast<i32>(row), .z = 0},
+            .imageExtent = {.width = buffers.width, .height = rows, .depth = 1},
+        };
+        u8* map = co_await stream.reserve(buffers.image, region, size);
+        if(!map) break;
+        write_image_rows(map, buffers, row, rows);
     }
 
-    buffers.image.transition(cmds, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED,
-                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                             VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                             VK_ACCESS_2_NONE, VK_ACCESS_2_TRANSFER_WRITE_BIT);
-    buffers.image.from_buffer(cmds, move(buffers.staging));
-    buffers.image.transition(cmds, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                             VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-                             VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
-                             VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT_KHR);
+    co_await stream.finish([&](rvk::Commands& cmds) {
+        buffers.image.transition(cmds, VK_IMAGE_ASPECT_COLOR_BIT,
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                 VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                                 VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_ACCESS_2_SHADER_READ_BIT_KHR);
+    });
+    if(stream.failed()) {
+        warn("Image too large for staging heap.");
+        co_return GPU_Image{};
+    }
 
-    return GPU_Image{
+    co_return GPU_Image{
         .image = move(buffers.image),
         .view = move(buffers.view),
     };
 }
 
-static Async::Task<GPU_Image> write_image_async(Async::Pool<>& pool, Image_Buffers buffers) {
-    co_await pool.suspend();
-    co_return co_await rvk::async(
-        pool, [&](rvk::Commands& cmds) { return write_image(cmds, move(buffers)); });
+static u64 blas_input_size(const Mesh_Ref& mesh) {
+    if(!mesh.check()) return 0;
+    return Math::align_pow2(mesh.positions.bytes() + mesh.indices.bytes(), 16) +
+           sizeof(VkTransformMatrixKHR);
 }
 
-static Result<BLAS_Buffers> allocate_blas(Slice<Mesh_Ref> meshes) {
+static Result<BLAS_Buffers> allocate_blas(Slice<const Mesh_Ref> object) {
+
+    constexpr VkBufferUsageFlags usage =
+        VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
 
-    u64 size = 0;
     Region(R) {
-        Vec<rvk::BLAS::Size, Mregion<R>> sizes(meshes.length());
+        Vec<rvk::BLAS::Size, Mregion<R>> sizes(object.length());
 
-        for(auto mesh : meshes) {
+        u64 size = 0;
+        for(auto& mesh : object) {
             if(!mesh.check()) continue;
-
-            u64 v = mesh.positions.bytes();
-            u64 i = mesh.indices.bytes();
-            u64 vi = Math::align_pow2(v + i, 16);
-
             sizes.push({mesh.positions.length() / 3, mesh.indices.length(), true,
                         mesh.flags.alpha_cutoff == 0.0f});
-            size += vi + sizeof(VkTransformMatrixKHR);
+            size += blas_input_size(mesh);
         }
 
         if(size == 0) return BLAS_Buffers{};
 
-        BIND_STAGING(staging, size);
-        BIND_DEVICE(geometry, size,
-                    VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-                        VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+        BIND_DEVICE(geometry, size, usage);
 
         auto blas = rvk::make_blas(sizes.slice());
         if(!blas.ok()) {
             return Device_Full{};
         }
 
-        return BLAS_Buffers{move(staging), move(geometry), move(*blas), meshes};
+        return BLAS_Buffers{move(geometry), move(*blas), object};
     }
 }
 
-static rvk::BLAS write_blas(rvk::Commands& cmds, BLAS_Buffers buffers) {
+// Fails as a whole if any object does not fit, unless partial is set, in which case only the
+// objects that do not fit are left without a BLAS.
+static Result<BLAS_Batch_Buffers> allocate_blas_batch(Slice<const Mesh_Ref> meshes,
+                                                      Slice<const u64> object_ends, bool partial) {
 
-    if(buffers.meshes.empty()) return rvk::BLAS{};
+    BLAS_Batch_Buffers ret;
+    ret.objects = Vec<BLAS_Buffers, Alloc>(object_ends.length());
 
-    Region(R) {
-        Vec<rvk::BLAS::Offset, Mregion<R>> offsets(buffers.meshes.length());
-
-        u64 offset = 0;
-        for(auto mesh : buffers.meshes) {
-            if(!mesh.check()) continue;
+    u64 begin = 0;
+    for(u64 end : object_ends) {
+        Slice<const Mesh_Ref> object{meshes.data() + begin, end - begin};
+        begin = end;
 
-            u64 v_size = mesh.positions.bytes();
-            u64 i_size = mesh.indices.bytes();
-            u64 vi_size_aligned = Math::align_pow2(v_size + i_size, 16);
+        bool fits = allocate_blas(object).match(Overload{
+            [&](BLAS_Buffers buffers) {
+                ret.objects.push(move(buffers));
+                return true;
+            },
+            [](Staging_Full) { return false; },
+            [](Device_Full) { return false; },
+        });
 
-            offsets.push({offset, offset + v_size, Opt{offset + vi_size_aligned},
-                          mesh.positions.length() / 3, mesh.indices.length(),
-                          mesh.flags.alpha_cutoff == 0.0f});
-            offset += vi_size_aligned + sizeof(VkTransformMatrixKHR);
+        if(!fits) {
+            if(!partial) return Device_Full{};
+            warn("Object too large for device heap.");
+            ret.objects.push(BLAS_Buffers{});
         }
+    }
 
-        u8* map = buffers.staging.map();
-        u64 i = 0;
-        for(auto& mesh : buffers.meshes) {
-            if(!mesh.check()) continue;
-
-            auto T = to_transform(mesh.T);
-            Libc::memcpy(map + offsets[i].vertex, mesh.positions.data(), mesh.positions.bytes());
-            Libc::memcpy(map + offsets[i].index, mesh.indices.data(), mesh.indices.bytes());
-            Libc::memcpy(map + *offsets[i].transform, &T, sizeof(VkTransformMatrixKHR));
-            i++;
-        }
+    return ret;
+}
 
-        buffers.device.move_from(cmds, move(buffers.staging));
+static Async::Task<void> stage_blas(Staging_Stream& stream, rvk::Buffer& device,
+                                    Slice<const Mesh_Ref> meshes,
+                                    Vec<rvk::BLAS::Offset, Alloc>& offsets) {
 
-        transfer_build_barrier(cmds);
+    u64 offset = 0;
+    for(auto& mesh : meshes) {
+        if(!mesh.check()) continue;
 
-        return rvk::build_blas(cmds, move(buffers.blas), move(buffers.device), offsets.slice());
+        // BLAS inputs keep f32 positions and u32 indices, the formats rvk builds from.
+        u64 v_size = mesh.positions.bytes();
+        u64 i_size = mesh.indices.bytes();
+        u64 vi_size_aligned = Math::align_pow2(v_size + i_size, 16);
+
+        auto T = to_transform(mesh.T);
+        co_await stream.write(device, offset, mesh.positions.to_bytes());
+        co_await stream.write(device, offset + v_size, mesh.indices.to_bytes());
+        co_await stream.write(device, offset + vi_size_aligned,
+                              Slice<const u8>{reinterpret_cast<const u8*>(&T), sizeof(T)});
+
+        offsets.push({offset, offset + v_size, Opt{offset + vi_size_aligned},
+                      mesh.vertex_count(), mesh.indices.length(),
+                      mesh.flags.alpha_cutoff == 0.0f});
+        offset += vi_size_aligned + sizeof(VkTransformMatrixKHR);
     }
 }
 
-static Async::Task<rvk::BLAS> write_blas_async(Async::Pool<>& pool, BLAS_Buffers buffers) {
+static Async::Task<Vec<rvk::BLAS, Alloc>>
+write_blas_batch_async(Async::Pool<>& pool, Staging_Ring& ring, BLAS_Batch_Buffers buffers) {
     co_await pool.suspend();
-    co_return co_await rvk::async(
-        pool, [&](rvk::Commands& cmds) { return write_blas(cmds, move(buffers)); });
+
+    Staging_Stream stream{pool, ring};
+
+    Vec<Vec<rvk::BLAS::Offset, Alloc>, Alloc> offsets(buffers.objects.length());
+    for(auto& object : buffers.objects) {
+        Vec<rvk::BLAS::Offset, Alloc> object_offsets(object.meshes.length());
+        if(object.device) {
+            co_await stage_blas(stream, object.device, object.meshes, object_offsets);
+        }
+        offsets.push(move(object_offsets));
+    }
+
+    Vec<rvk::BLAS, Alloc> out(buffers.objects.length());
+
+    co_await stream.finish([&](rvk::Commands& cmds) {
+        // Copies submitted earlier in the stream precede this barrier in submission order,
+        // so one barrier covers every copy in the batch.
+        transfer_build_barrier(cmds);
+
+        for(u64 i = 0; i < buffers.objects.length(); i++) {
+            auto& object = buffers.objects[i];
+            if(object.device) {
+                out.push(rvk::build_blas(cmds, move(object.blas), move(object.device),
+                                         offsets[i].slice()));
+            } else {
+                out.push(rvk::BLAS{});
+            }
+        }
+    });
+
+    if(stream.failed()) {
+        warn("BLAS batch too large for staging heap.");
+    }
+    co_return out;
 }
 
 static Result<TLAS_Buffers> allocate_tlas(Slice<rvk::TLAS::Instance> instances) {
@@ -1096,855 +2180,1585 @@ Async::Task<void> Scene::await_all(Vec<Async::Task<GPU_Image>, Alloc>& image_tas
     image_tasks.clear();
 }
 
-Async::Task<void> Scene::await_all(Vec<Async::Task<rvk::BLAS>, Alloc>& blas_tasks,
-                                   Vec<Async::Task<Geometry_Result>, Alloc>& geom_tasks) {
-
-    for(auto& t : blas_tasks) {
-        object_blases.push(co_await t);
-    }
-    blas_tasks.clear();
-
-    for(auto& t : geom_tasks) {
-        object_to_geometry_index.push(cpu_geometry_references.length());
-        auto [geometry_buffer, geometry_references] = co_await t;
-        geometry_buffers.push(move(geometry_buffer));
-        for(auto& ref : geometry_references) {
-            cpu_geometry_references.push(ref);
-        }
-    }
-    geom_tasks.clear();
-}
-
 template<typename T>
 static bool out_of_memory(const Result<T>& result) {
     return result.match(Overload{
         [](const Staging_Full&) {
-            warn("Out of staging memory, draining tasks...");
+            warn("Out of staging memory, waiting for other uploads...");
             return true;
         },
         [](const Device_Full&) {
-            warn("Out of device memory, draining tasks...");
+            warn("Out of device memory, waiting for other uploads...");
             return true;
         },
         [](const auto&) { return false; },
     });
 }
 
-Async::Task<void> Scene::upload(Async::Pool<>& pool, const PBRT::Scene& cpu, u32 parallelism) {
+// Bounds the device bytes and tasks that all upload stages have in flight, and owns the
+// staging ring they share. Work is admitted as soon as any finished task returns enough of the
+// budget.
+struct Upload_Budget {
 
-    co_await pool.suspend();
+    struct Cost {
+        u64 device = 0;
+    };
 
-    { // Phase 1: top level BLAS
-        Profile::Time_Point start = Profile::timestamp();
+    explicit Upload_Budget(const Config& config)
+        : staging(config.staging_budget), limit{config.device_budget},
+          max_tasks(config.max_uploads) {
+    }
 
-        Vec<Mesh_Ref, Alloc> non_emissive_meshes(cpu.top_level_meshes.length());
-        Vec<Mesh_Ref, Alloc> emissive_meshes(cpu.top_level_meshes.length());
+    Staging_Ring staging;
 
-        for(auto mesh_id : cpu.top_level_meshes) {
-            if(cpu.meshes[mesh_id.id].emission != Vec3{0.0f}) {
-                emissive_meshes.push(Mesh_Ref{cpu, mesh_id});
-            } else {
-                non_emissive_meshes.push(Mesh_Ref{cpu, mesh_id});
-            }
+    Async::Task<void> acquire(Async::Pool<>& pool, Cost cost) {
+        while(!try_acquire(cost)) {
+            co_await waiters.wait([&] { return admits(cost); });
+            co_await pool.suspend();
         }
+    }
 
-        auto blas_task =
-            allocate_blas(non_emissive_meshes.slice())
-                .match(Overload{
-                    [&](BLAS_Buffers buffers) { return write_blas_async(pool, move(buffers)); },
-                    [&](Staging_Full) -> Async::Task<rvk::BLAS> {
-                        warn("Top level BLAS too large for staging heap.");
-                        co_return rvk::BLAS{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::BLAS> {
-                        warn("Top level BLAS too large for device heap.");
-                        co_return rvk::BLAS{};
-                    },
-                });
-        auto emissive_blas_task =
-            allocate_blas(emissive_meshes.slice())
-                .match(Overload{
-                    [&](BLAS_Buffers buffers) { return write_blas_async(pool, move(buffers)); },
-                    [&](Staging_Full) -> Async::Task<rvk::BLAS> {
-                        warn("Emissive BLAS too large for staging heap.");
-                        co_return rvk::BLAS{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::BLAS> {
-                        warn("Emissive BLAS too large for device heap.");
-                        co_return rvk::BLAS{};
-                    },
-                });
-
-        object_blases.push(co_await blas_task);
-        object_blases.push(co_await emissive_blas_task);
-
-        auto geom_task = allocate_geometry(non_emissive_meshes.slice())
-                             .match(Overload{
-                                 [&](Geometry_Buffers buffers) {
-                                     return write_geometry_async(pool, move(buffers));
-                                 },
-                                 [&](Staging_Full) -> Async::Task<Geometry_Result> {
-                                     warn("Top level geometry too large for staging heap.");
-                                     co_return Geometry_Result{};
-                                 },
-                                 [&](Device_Full) -> Async::Task<Geometry_Result> {
-                                     warn("Top level geometry too large for device heap.");
-                                     co_return Geometry_Result{};
-                                 },
-                             });
-        auto emissive_geom_task = allocate_geometry(emissive_meshes.slice())
-                                      .match(Overload{
-                                          [&](Geometry_Buffers buffers) {
-                                              return write_geometry_async(pool, move(buffers));
-                                          },
-                                          [&](Staging_Full) -> Async::Task<Geometry_Result> {
-                                              warn("Emissive geometry too large for staging heap.");
-                                              co_return Geometry_Result{};
-                                          },
-                                          [&](Device_Full) -> Async::Task<Geometry_Result> {
-                                              warn("Emissive geometry too large for device heap.");
-                                              co_return Geometry_Result{};
-                                          },
-                                      });
-
+    // Blocks new work until the caller is the only task left holding budget, so that an
+    // allocation that ran out of heap space can be retried with the heap otherwise idle. Only
+    // one task is exclusive at a time; the others queue behind it until it calls end_exclusive.
+    Async::Task<void> wait_exclusive(Async::Pool<>& pool) {
         {
-            object_to_geometry_index.push(cpu_geometry_references.length());
-
-            auto [geometry_buffer, geometry_references] = co_await geom_task;
-            geometry_buffers.push(move(geometry_buffer));
-            for(auto& ref : geometry_references) {
-                cpu_geometry_references.push(ref);
-            }
+            Thread::Lock lock(mutex);
+            draining++;
         }
-        {
-            object_to_geometry_index.push(cpu_geometry_references.length());
+        while(!try_exclusive()) {
+            co_await waiters.wait([this] { return exclusive(); });
+            co_await pool.suspend();
+        }
+    }
 
-            auto [emissive_geometry_buffer, emissive_geometry_references] =
-                co_await emissive_geom_task;
-            geometry_buffers.push(move(emissive_geometry_buffer));
-            for(auto& ref : emissive_geometry_references) {
-                cpu_geometry_references.push(ref);
-            }
+    void end_exclusive() {
+        {
+            Thread::Lock lock(mutex);
+            exclusive_held = false;
+            draining--;
         }
+        waiters.wake();
+    }
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built top level BLASes for % meshes in % ms.", cpu.top_level_meshes.length(),
-             Profile::ms(end - start));
+    void release(Cost cost) {
+        {
+            Thread::Lock lock(mutex);
+            used.device -= cost.device;
+            tasks--;
+        }
+        waiters.wake();
     }
 
-    { // Phase 2: instance BLASes
-        Profile::Time_Point start = Profile::timestamp();
+private:
+    [[nodiscard]] bool try_acquire(Cost cost) {
+        Thread::Lock lock(mutex);
+        if(!admits(cost)) return false;
+        used.device += cost.device;
+        tasks++;
+        return true;
+    }
 
-        Vec<Vec<Mesh_Ref, Alloc>, Alloc> mesh_refs(cpu.objects.length());
-        Vec<Async::Task<rvk::BLAS>, Alloc> blas_tasks(parallelism);
-        Vec<Async::Task<Geometry_Result>, Alloc> geom_tasks(parallelism);
+    [[nodiscard]] bool try_exclusive() {
+        Thread::Lock lock(mutex);
+        if(!exclusive()) return false;
+        exclusive_held = true;
+        return true;
+    }
 
-        u64 mesh_count = 0;
+    // The checks below are called with the mutex held.
+    [[nodiscard]] bool admits(Cost cost) const {
+        // Work larger than the whole budget is admitted once nothing else is in flight.
+        if(tasks == 0) return true;
+        if(draining > 0 || tasks >= max_tasks) return false;
+        return used.device + cost.device <= limit.device;
+    }
 
-        for(u64 obj_idx = 0; obj_idx < cpu.objects.length(); obj_idx++) {
+    // Every task still holding budget is waiting to drain, and none of them has the heap yet.
+    [[nodiscard]] bool exclusive() const {
+        return !exclusive_held && tasks <= draining;
+    }
 
-            auto& obj = cpu.objects[obj_idx];
+    Thread::Mutex mutex;
+    Wait_Queue waiters{mutex};
+    Cost limit;
+    Cost used;
+    u64 max_tasks = 0;
+    u64 tasks = 0;
+    u64 draining = 0;
+    bool exclusive_held = false;
+};
 
-            Vec<Mesh_Ref, Alloc> refs(obj.meshes.length());
-            for(auto mesh_id : obj.meshes) {
-                refs.push(Mesh_Ref{cpu, mesh_id});
-                mesh_count++;
-            }
+struct Batch_Result {
+    Vec<rvk::BLAS, Alloc> blases;
+    Geometry_Result geometry;
+    Vec<u64, Alloc> object_ends;
+};
 
-            if(blas_tasks.full() || geom_tasks.full()) {
-                co_await await_all(blas_tasks, geom_tasks);
-            }
+static u64 device_size(const Mesh_Ref& mesh) {
+    // Acceleration structures take roughly as much device memory as their inputs, which each
+    // BLAS owns for its lifetime.
+    return 2 * blas_input_size(mesh) + geometry_size(mesh);
+}
 
-            auto blas = allocate_blas(refs.slice());
-            if(out_of_memory(blas)) {
-                co_await await_all(blas_tasks, geom_tasks);
-                blas = allocate_blas(refs.slice());
-            }
+// Owns the vertices and indices of pieces split off oversized meshes until they are uploaded.
+struct Mesh_Pieces {
+    Vec<Vec<f32, Alloc>, Alloc> attributes;
+    Vec<Vec<u32, Alloc>, Alloc> indices;
+};
 
-            blas_tasks.push(move(blas).match(Overload{
-                [&](BLAS_Buffers buffers) { return write_blas_async(pool, move(buffers)); },
-                [&](Staging_Full) -> Async::Task<rvk::BLAS> {
-                    warn("BLAS too large for staging heap.");
-                    co_return rvk::BLAS{};
-                },
-                [&](Device_Full) -> Async::Task<rvk::BLAS> {
-                    warn("BLAS too large for device heap.");
-                    co_return rvk::BLAS{};
-                },
-            }));
+// Splits a mesh whose device footprint exceeds max_bytes into triangle ranges. Each piece gets
+// a compacted copy of the vertices it references, so it can become a BLAS of its own.
+static void split_mesh(const Mesh_Ref& mesh, u64 max_bytes, Mesh_Pieces& pieces,
+                       Vec<Mesh_Ref, Alloc>& out) {
 
-            auto geometry = allocate_geometry(refs.slice());
-            if(out_of_memory(geometry)) {
-                co_await await_all(blas_tasks, geom_tasks);
-                geometry = allocate_geometry(refs.slice());
-            }
+    u64 size = device_size(mesh);
+    u64 triangles = mesh.indices.length() / 3;
+    if(size <= max_bytes || triangles <= 1) {
+        out.push(mesh);
+        return;
+    }
 
-            geom_tasks.push(move(geometry).match(Overload{
-                [&](Geometry_Buffers buffers) { return write_geometry_async(pool, move(buffers)); },
-                [&](Staging_Full) -> Async::Task<Geometry_Result> {
-                    warn("Geometry too large for staging heap.");
-                    co_return Geometry_Result{};
-                },
-                [&](Device_Full) -> Async::Task<Geometry_Result> {
-                    warn("Geometry too large for device heap.");
-                    co_return Geometry_Result{};
-                },
-            }));
+    u64 count = (size + max_bytes - 1) / max_bytes;
+    u64 per_piece = (triangles + count - 1) / count;
 
-            mesh_refs.push(move(refs));
-        }
+    Vec<u32, Alloc> remap(mesh.vertex_count());
+    for(u64 v = 0; v < mesh.vertex_count(); v++) {
+        remap.push(RPP_UINT32_MAX);
+    }
 
-        co_await await_all(blas_tasks, geom_tasks);
+    for(u64 begin = 0; begin < triangles; begin += per_piece) {
+        u64 end = Math::min(begin + per_piece, triangles);
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % instance BLASes for % meshes in % ms.", cpu.objects.length(), mesh_count,
-             Profile::ms(end - start));
-    }
+        Vec<u32, Alloc> vertices;
+        Vec<u32, Alloc> indices((end - begin) * 3);
+        for(u64 i = begin * 3; i < end * 3; i++) {
+            u32 v = Math::min(mesh.indices[i], static_cast<u32>(mesh.vertex_count() - 1));
+            if(remap[v] == RPP_UINT32_MAX) {
+                remap[v] = static_cast<u32>(vertices.length());
+                vertices.push(v);
+            }
+            indices.push(remap[v]);
+        }
+        for(u32 v : vertices) {
+            remap[v] = RPP_UINT32_MAX;
+        }
 
-    Traversal_Result traversal;
-    {
-        Profile::Time_Point start = Profile::timestamp();
-        traversal = traverse(cpu);
-        Profile::Time_Point end = Profile::timestamp();
-        info("Traversed scene in % ms.", Profile::ms(end - start));
-    }
+        auto gather = [&](Slice<const f32> src, u64 width) {
+            if(src.empty()) return src;
+            Vec<f32, Alloc> dst(vertices.length() * width);
+            for(u32 v : vertices) {
+                for(u64 c = 0; c < width; c++) dst.push(src[v * width + c]);
+            }
+            pieces.attributes.push(move(dst));
+            auto& stored = pieces.attributes[pieces.attributes.length() - 1];
+            return Slice<const f32>{stored.data(), stored.length()};
+        };
 
-    { // Phase 3: TLASes (depend on BLASes)
-        Profile::Time_Point start = Profile::timestamp();
+        Mesh_Ref piece = mesh;
+        piece.positions = gather(mesh.positions, 3);
+        piece.normals = gather(mesh.normals, 3);
+        piece.tangents = gather(mesh.tangents, 3);
+        piece.uvs = gather(mesh.uvs, 2);
 
-        auto tlas_task =
-            allocate_tlas(traversal.instances.slice())
-                .match(Overload{
-                    [&](TLAS_Buffers buffers) { return write_tlas_async(pool, move(buffers)); },
-                    [&](Staging_Full) -> Async::Task<rvk::TLAS> {
-                        warn("TLAS too large for staging heap.");
-                        co_return rvk::TLAS{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::TLAS> {
-                        warn("TLAS too large for device heap.");
-                        co_return rvk::TLAS{};
-                    },
-                });
-
-        tlas = co_await tlas_task;
-
-        auto emissive_tlas_task =
-            allocate_tlas(traversal.emissive_instances.slice())
-                .match(Overload{
-                    [&](TLAS_Buffers buffers) { return write_tlas_async(pool, move(buffers)); },
-                    [&](Staging_Full) -> Async::Task<rvk::TLAS> {
-                        warn("Emissive TLAS too large for staging heap.");
-                        co_return rvk::TLAS{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::TLAS> {
-                        warn("Emissive TLAS too large for device heap.");
-                        co_return rvk::TLAS{};
-                    },
-                });
-
-        emissive_tlas = co_await emissive_tlas_task;
+        pieces.indices.push(move(indices));
+        auto& stored = pieces.indices[pieces.indices.length() - 1];
+        piece.indices = Slice<const u32>{stored.data(), stored.length()};
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built TLASes from % instances (% emissive) in % ms.", traversal.instances.length(),
-             traversal.emissive_instances.length(), Profile::ms(end - start));
+        out.push(move(piece));
     }
+}
 
-    { // Phase 4: textures
-        Profile::Time_Point start = Profile::timestamp();
-
-        Vec<Async::Task<GPU_Image>, Alloc> image_tasks(parallelism);
+// Moves a copy of a mesh into the space of one of its instances, so it can join the top level
+// clusters. Shading frames are transformed like the hit shaders transform instanced ones.
+static Mesh_Ref bake_mesh(const Mesh_Ref& mesh, Mat4 instance_to_world, Mesh_Pieces& pieces) {
 
-        u64 image_count = 0;
+    Mat4 normal_to_world = instance_to_world.inverse().T();
 
-        // First sampler is for environment map
-        {
-            rvk::Sampler::Config config{
-                .min = VK_FILTER_LINEAR,
-                .mag = VK_FILTER_LINEAR,
-                .u = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-                .v = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-                .w = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
-            };
-            sampler_configs.insert(config, 0);
-            samplers.push(rvk::make_sampler(config));
-        }
-
-        for(u64 tex_idx = 0; tex_idx < cpu.textures.length(); tex_idx++) {
-
-            auto& tex = cpu.textures[tex_idx];
-
-            { // Find sampler
-                auto config = sampler_config(tex);
-                if(auto sampler_idx = sampler_configs.try_get(config); sampler_idx.ok()) {
-                    texture_to_sampler_index.push(**sampler_idx);
-                } else {
-                    u64 idx = samplers.length();
-                    texture_to_sampler_index.push(idx);
-                    sampler_configs.insert(config, idx);
-                    samplers.push(rvk::make_sampler(config));
-                }
-            }
+    auto transform = [&](Slice<const f32> src) {
+        if(src.empty()) return src;
+        Vec<f32, Alloc> dst(src.length());
+        for(u64 i = 0; i + 2 < src.length(); i += 3) {
+            Vec3 v = Math::normalize(normal_to_world.rotate(Vec3{src[i], src[i + 1], src[i + 2]}));
+            dst.push(v.x);
+            dst.push(v.y);
+            dst.push(v.z);
+        }
+        pieces.attributes.push(move(dst));
+        auto& stored = pieces.attributes[pieces.attributes.length() - 1];
+        return Slice<const f32>{stored.data(), stored.length()};
+    };
 
-            { // Find image
-                if(tex.type == PBRT::Textures::Type::imagemap) {
-                    texture_to_image_index.push(image_count++);
-                } else {
-                    texture_to_image_index.push(RPP_UINT64_MAX);
-                    continue;
-                }
-            }
+    Mesh_Ref baked = mesh;
+    baked.T = instance_to_world * mesh.T;
+    baked.normals = transform(mesh.normals);
+    baked.tangents = transform(mesh.tangents);
+    return baked;
+}
 
-            if(image_tasks.full()) {
-                co_await await_all(image_tasks);
-            }
+// Groups the meshes of an object into parts whose device footprint fits in max_bytes. Each part
+// becomes a BLAS of its own.
+static void split_object(Slice<const Mesh_Ref> object, u64 max_bytes,
+                         Vec<Vec<Mesh_Ref, Alloc>, Alloc>& parts) {
 
-            auto image = allocate_image(tex);
-            if(out_of_memory(image)) {
-                co_await await_all(image_tasks);
-                image = allocate_image(tex);
-            }
+    Vec<Mesh_Ref, Alloc> part;
+    u64 size = 0;
 
-            image_tasks.push(move(image).match(Overload{
-                [&](Image_Buffers buffers) { return write_image_async(pool, move(buffers)); },
-                [&](Staging_Full) -> Async::Task<GPU_Image> {
-                    warn("Image too large for staging heap.");
-                    co_return GPU_Image{};
-                },
-                [&](Device_Full) -> Async::Task<GPU_Image> {
-                    warn("Image too large for device heap.");
-                    co_return GPU_Image{};
-                },
-            }));
+    for(auto& mesh : object) {
+        u64 mesh_size = device_size(mesh);
+        if(!part.empty() && size + mesh_size > max_bytes) {
+            parts.push(move(part));
+            part = Vec<Mesh_Ref, Alloc>{};
+            size = 0;
         }
+        part.push(mesh);
+        size += mesh_size;
+    }
 
-        co_await await_all(image_tasks);
+    if(!part.empty()) parts.push(move(part));
+}
 
-        if(image_count >= MAX_IMAGES) {
-            warn("Too many images, only the first % of % will be present.", MAX_IMAGES,
-                 image_count);
-        }
-        if(samplers.length() >= MAX_SAMPLERS) {
-            warn("Too many samplers, only the first % of % will be present.", MAX_SAMPLERS,
-                 samplers.length());
-        }
+// Accumulates objects until a batch is worth a submission of its own.
+struct Object_Batcher {
+    Vec<Mesh_Ref, Alloc> meshes;
+    Vec<u64, Alloc> object_ends;
+    u64 bytes = 0;
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % images from % textures in % ms.", image_count, cpu.textures.length(),
-             Profile::ms(end - start));
+    [[nodiscard]] bool empty() const {
+        return object_ends.empty();
+    }
+    [[nodiscard]] bool full_with(Slice<const Mesh_Ref> object) const {
+        if(empty()) return false;
+        u64 object_bytes = 0;
+        for(auto& mesh : object) object_bytes += blas_input_size(mesh);
+        return bytes + object_bytes > BATCH_BYTES || object_ends.length() >= BATCH_OBJECTS;
     }
+    void add(Slice<const Mesh_Ref> object) {
+        for(auto& mesh : object) {
+            meshes.push(mesh);
+            bytes += blas_input_size(mesh);
+        }
+        object_ends.push(meshes.length());
+    }
+    [[nodiscard]] Upload_Budget::Cost cost() const {
+        u64 device = 0;
+        for(auto& mesh : meshes) device += device_size(mesh);
+        return Upload_Budget::Cost{device};
+    }
+};
 
-    { // Phase 5: geometry references (depends on BLASes and textures)
-        Profile::Time_Point start = Profile::timestamp();
+static Async::Task<Batch_Result> upload_batch(Async::Pool<>& pool, Upload_Budget& budget,
+                                              const Config& config, Vec<Mesh_Ref, Alloc> meshes,
+                                              Vec<u64, Alloc> object_ends,
+                                              Upload_Budget::Cost cost) {
+    co_await pool.suspend();
 
-        auto geom_ref_task =
-            allocate_geometry_references(cpu_geometry_references.slice(),
-                                         texture_to_image_index.slice(),
-                                         texture_to_sampler_index.slice())
-                .match(Overload{
-                    [&](Geometry_Reference_Buffers buffers) {
-                        return write_geometry_references_async(pool, move(buffers));
-                    },
-                    [&](Staging_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Geometry references too large for staging heap.");
-                        co_return rvk::Buffer{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Geometry references too large for device heap.");
-                        co_return rvk::Buffer{};
-                    },
-                });
-
-        gpu_geometry_references = co_await geom_ref_task;
+    auto blas = allocate_blas_batch(meshes.slice(), object_ends.slice(), false);
+    if(out_of_memory(blas)) {
+        co_await budget.wait_exclusive(pool);
+        // Fall back to allocating each object on its own, so one object that does not fit
+        // does not drop the rest of the batch.
+        blas = allocate_blas_batch(meshes.slice(), object_ends.slice(), true);
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % geometry references in % ms.", cpu_geometry_references.length(),
-             Profile::ms(end - start));
+        budget.end_exclusive();
     }
 
-    { // Phase 6: materials (depends on textures)
-        Profile::Time_Point start = Profile::timestamp();
-
-        auto materials_task =
-            allocate_materials(cpu.materials.slice(), texture_to_image_index.slice(),
-                               texture_to_sampler_index.slice())
-                .match(Overload{
-                    [&](Materials_Buffers<PBRT::Material> buffers) {
-                        return write_materials_async<PBRT::Scene>(pool, cpu, move(buffers));
-                    },
-                    [&](Staging_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Materials too large for staging heap.");
-                        co_return rvk::Buffer{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Materials too large for device heap.");
-                        co_return rvk::Buffer{};
-                    },
-                });
-
-        materials = co_await materials_task;
+    auto blas_task = move(blas).match(Overload{
+        [&](BLAS_Batch_Buffers buffers) {
+            return write_blas_batch_async(pool, budget.staging, move(buffers));
+        },
+        [&](Staging_Full) -> Async::Task<Vec<rvk::BLAS, Alloc>> {
+            warn("BLAS batch too large for staging heap.");
+            co_return Vec<rvk::BLAS, Alloc>{};
+        },
+        [&](Device_Full) -> Async::Task<Vec<rvk::BLAS, Alloc>> {
+            warn("BLAS batch too large for device heap.");
+            co_return Vec<rvk::BLAS, Alloc>{};
+        },
+    });
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % materials in % ms.", cpu.materials.length(), Profile::ms(end - start));
+    auto geometry = allocate_geometry(meshes.slice());
+    if(out_of_memory(geometry)) {
+        co_await budget.wait_exclusive(pool);
+        geometry = allocate_geometry(meshes.slice());
+        budget.end_exclusive();
     }
 
-    { // Phase 7: lights
-        Profile::Time_Point start = Profile::timestamp();
-
-        Vec<Pair<Mat4, u32>, Alloc> t_lights(cpu.lights.length());
-        for(u32 i = 0; i < cpu.lights.length(); i++) {
-            if(cpu.lights[i].type == PBRT::Lights::Type::infinite) {
-                if(environment_map.image) {
-                    warn("Multiple environment maps detected, only the first one will be used.");
-                    continue;
-                }
-                auto image_task = allocate_envmap(cpu.lights[i])
-                                      .match(Overload{
-                                          [&](Image_Buffers buffers) {
-                                              return write_image_async(pool, move(buffers));
-                                          },
-                                          [&](Staging_Full) -> Async::Task<GPU_Image> {
-                                              warn("Envmap too large for staging heap.");
-                                              co_return GPU_Image{};
-                                          },
-                                          [&](Device_Full) -> Async::Task<GPU_Image> {
-                                              warn("Envmap too large for device heap.");
-                                              co_return GPU_Image{};
-                                          },
-                                      });
-                environment_map = co_await image_task;
-            } else {
-                t_lights.push(Pair{Mat4::I, i});
-            }
-        }
+    auto geometry_task = move(geometry).match(Overload{
+        [&](Geometry_Buffers buffers) {
+            return write_geometry_async(pool, budget.staging, move(buffers));
+        },
+        [&](Staging_Full) -> Async::Task<Geometry_Result> {
+            warn("Geometry batch too large for staging heap.");
+            co_return Geometry_Result{};
+        },
+        [&](Device_Full) -> Async::Task<Geometry_Result> {
+            warn("Geometry batch too large for device heap.");
+            co_return Geometry_Result{};
+        },
+    });
 
-        auto lights_task =
-            allocate_lights<PBRT::Light>(t_lights.slice())
-                .match(Overload{
-                    [&](Lights_Buffers<PBRT::Light> buffers) {
-                        return write_lights_async<PBRT::Scene>(pool, cpu, move(buffers));
-                    },
-                    [&](Staging_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Lights too large for staging heap.");
-                        co_return rvk::Buffer{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Lights too large for device heap.");
-                        co_return rvk::Buffer{};
-                    },
-                });
-
-        lights = co_await lights_task;
+    auto blases = co_await blas_task;
+    auto geometry_result = co_await geometry_task;
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % lights in % ms.", cpu.lights.length(), Profile::ms(end - start));
-    }
+    budget.release(cost);
 
-    recreate_set();
+    co_return Batch_Result{move(blases), move(geometry_result), move(object_ends)};
 }
 
-Async::Task<void> Scene::upload(Async::Pool<>& pool, const GLTF::Scene& cpu, u32 parallelism) {
-    co_await pool.suspend();
+static Async::Task<void> enqueue(Async::Pool<>& pool, Upload_Budget& budget, const Config& config,
+                                 Vec<Async::Task<Batch_Result>, Alloc>& batches,
+                                 Object_Batcher& batcher) {
 
-    { // Phase 1: mesh BLASes
-        Profile::Time_Point start = Profile::timestamp();
+    if(batcher.empty()) co_return;
 
-        Vec<Vec<Mesh_Ref, Alloc>, Alloc> mesh_refs(cpu.meshes.length());
-        Vec<Async::Task<rvk::BLAS>, Alloc> blas_tasks(parallelism);
-        Vec<Async::Task<Geometry_Result>, Alloc> geom_tasks(parallelism);
+    auto cost = batcher.cost();
+    co_await budget.acquire(pool, cost);
 
-        for(u64 mesh_idx = 0; mesh_idx < cpu.meshes.length(); mesh_idx++) {
+    batches.push(upload_batch(pool, budget, config, move(batcher.meshes),
+                              move(batcher.object_ends), cost));
+    batcher = Object_Batcher{};
+}
 
-            auto& mesh = cpu.meshes[mesh_idx];
-            Vec<Mesh_Ref, Alloc> refs(mesh.primitives.length());
-            for(auto& prim : mesh.primitives) {
-                refs.push(Mesh_Ref{cpu, prim, mesh_idx});
-            }
+static void log_reductions(Slice<const u32> reductions) {
+    u64 reduced = 0;
+    u32 most = 0;
+    for(u32 reduction : reductions) {
+        if(reduction) reduced++;
+        most = Math::max(most, reduction);
+    }
+    if(reduced) {
+        info("Reduced % of % images by up to % levels to fit the texture budget.", reduced,
+             reductions.length(), most);
+    }
+}
+
+static Upload_Budget::Cost image_cost(const Image_Source& source, u32 reduction) {
+    return Upload_Budget::Cost{source.staging_size(reduction)};
+}
+
+template<typename Texture>
+static Async::Task<GPU_Image> upload_image(Async::Pool<>& pool, Upload_Budget& budget,
+                                           const Texture& texture, Image_Source source,
+                                           u32 reduction, HDR_Format hdr_format,
+                                           const Texture_Cache::Config* texture_cache,
+                                           Upload_Budget::Cost cost) {
+    co_await pool.suspend();
+
+    if(source.hdr_widened) {
+        warn("HDR image values do not fit %; uploading it in a wider format.", hdr_format);
+    }
+
+    // Images decoded for this load are encoded once into the texture cache, then uploaded from
+    // the encoded image like a precompressed one. The entry is written while the image uploads.
+    Compressed::Image encoded;
+    Async::Task<void> caching;
+    if(texture_cache && texture.cache_key && !source.compressed && source.staging_size()) {
+        encoded = encode_image(source);
+        caching = Texture_Cache::write(pool, *texture_cache, texture.cache_key, encoded);
+        source.compressed = &encoded;
+    }
+    Vec<u8, Alloc> ldr_storage;
+    Vec<f32, Alloc> hdr_storage;
+    if(reduction) reduce_image(source, reduction, ldr_storage, hdr_storage);
+
+    auto image = allocate_image(source);
+    if(out_of_memory(image)) {
+        co_await budget.wait_exclusive(pool);
+        image = allocate_image(source);
+        // If the heap is still full, fall back to smaller versions of the image.
+        while(out_of_memory(image) && source.reducible()) {
+            reduce_image(source, 1, ldr_storage, hdr_storage);
+            image = allocate_image(source);
+        }
+        budget.end_exclusive();
+    }
+
+    GPU_Image result = co_await move(image).match(Overload{
+        [&](Image_Buffers buffers) {
+            return write_image_async(pool, budget.staging, move(buffers));
+        },
+        [&](Staging_Full) -> Async::Task<GPU_Image> {
+            warn("Image too large for staging heap.");
+            co_return GPU_Image{};
+        },
+        [&](Device_Full) -> Async::Task<GPU_Image> {
+            warn("Image too large for device heap.");
+            co_return GPU_Image{};
+        },
+    });
+
+    budget.release(cost);
+
+    // The entry is written from encoded, which must outlive the write.
+    if(caching.ok()) co_await caching;
+
+    co_return result;
+}
+
+// Streamed images first upload reduced to the tail extent, or to their planned reduction if
+// that is smaller.
+static Streamed_Image stream_tail(const Image_Source& source, u64 index, u32 ceiling,
+                                  const Config& config) {
+    u32 extent = Math::max(source.width, source.height);
+    u32 reduction = ceiling;
+    while(reduced_extent(extent, reduction) > Math::max(config.stream_tail_extent, 1u)) {
+        reduction++;
+    }
+    return Streamed_Image{
+        .texture = index, .extent = extent, .ceiling = ceiling, .resident = reduction};
+}
+
+// Uploads each requested image at its new reduction. The caller swaps the results in, so images
+// that fail to upload come back empty and keep their resident version. Once cancelled, no more
+// uploads start and the requests not yet started come back empty too.
+template<typename Texture>
+static Async::Task<Vec<Streamed_Upload, Alloc>>
+stream_images(Async::Pool<>& pool, Config config, Slice<const Texture> textures,
+              Vec<Streamed_Upload, Alloc> requests, Stream_Cancel& cancel) {
+    co_await pool.suspend();
+
+    Profile::Time_Point start = Profile::timestamp();
 
-            if(blas_tasks.full() || geom_tasks.full()) {
-                co_await await_all(blas_tasks, geom_tasks);
+    Upload_Budget budget{config};
+    Vec<Async::Task<GPU_Image>, Alloc> image_tasks(requests.length());
+
+    for(auto& request : requests) {
+        {
+            Thread::Lock lock{cancel.mutex};
+            if(cancel.cancelled) break;
+        }
+        auto& texture = textures[request.texture];
+        auto source = image_source(texture, config.compress_textures, config.hdr_format);
+        auto cost = image_cost(source, request.reduction);
+        co_await budget.acquire(pool, cost);
+        image_tasks.push(upload_image(pool, budget, texture, move(source), request.reduction,
+                                      config.hdr_format, null, cost));
+    }
+    for(u64 i = 0; i < image_tasks.length(); i++) {
+        requests[i].gpu = co_await image_tasks[i];
+    }
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Streamed % images in % ms.", image_tasks.length(), Profile::ms(end - start));
+
+    co_return requests;
+}
+
+// Batches finish in any order, but their results are stored in submission order. Unless wait is
+// set, merging stops at the first batch that is still running, so a snapshot can show the
+// finished prefix while later batches are enqueued. A snapshot in flight traverses the merged
+// BLASes, so merging also stops until it has been published.
+template<typename CPU_Scene>
+Async::Task<void> Scene::merge_batches(Async::Pool<>& pool, const CPU_Scene& cpu,
+                                       Vec<Async::Task<Batch_Result>, Alloc>& batches,
+                                       u64& merged, bool wait) {
+
+    for(; merged < batches.length(); merged++) {
+        if(snapshot_task.ok()) {
+            if(!wait && !snapshot_task.done()) break;
+            co_await snapshot_task;
+            snapshot_task = {};
+        }
+
+        auto& task = batches[merged];
+        if(!wait && !task.done()) break;
+
+        auto [blases, geometry, object_ends] = co_await task;
+
+        for(u64 i = 0; i < object_ends.length(); i++) {
+            object_blases.push(i < blases.length() ? move(blases[i]) : rvk::BLAS{});
+        }
+
+        auto& [geometry_buffer, geometry_references] = geometry;
+        geometry_buffers.push(move(geometry_buffer));
+
+        u64 mesh = 0;
+        for(u64 end : object_ends) {
+            u64 begin = cpu_geometry_references.length();
+            object_to_geometry_index.push(begin);
+            for(; mesh < end && mesh < geometry_references.length(); mesh++) {
+                cpu_geometry_references.push(geometry_references[mesh]);
             }
+            blas_records.push(hit_records(begin, cpu_geometry_references.length()));
+        }
+
+        try_snapshot(pool, cpu);
+    }
+
+    if(wait) {
+        batches.clear();
+        merged = 0;
+        if(snapshot_task.ok()) co_await snapshot_task;
+        snapshot_task = {};
+    }
+}
 
-            auto blas = allocate_blas(refs.slice());
-            if(out_of_memory(blas)) {
-                co_await await_all(blas_tasks, geom_tasks);
-                blas = allocate_blas(refs.slice());
+// The hit group of a geometry only depends on its material type, so BLASes whose geometries have
+// the same types in the same order share one run of hit records. Returns the first record of the
+// run for geometries [begin, end).
+u32 Scene::hit_records(u64 begin, u64 end) {
+
+    u64 hash = Digest::combine(0, end - begin);
+    for(u64 g = begin; g < end; g++) {
+        hash = Digest::combine(hash, static_cast<u64>(cpu_geometry_references[g].material_type));
+    }
+
+    auto matches = [&](u32 run) {
+        if(run + (end - begin) > record_geometry.length()) return false;
+        for(u64 g = begin; g < end; g++) {
+            u64 other = record_geometry[run + (g - begin)];
+            if(cpu_geometry_references[other].material_type !=
+               cpu_geometry_references[g].material_type) {
+                return false;
             }
+        }
+        return true;
+    };
 
-            blas_tasks.push(move(blas).match(Overload{
-                [&](BLAS_Buffers buffers) { return write_blas_async(pool, move(buffers)); },
-                [&](Staging_Full) -> Async::Task<rvk::BLAS> {
-                    warn("BLAS too large for staging heap.");
-                    co_return rvk::BLAS{};
+    if(auto run = record_runs.try_get(hash); run.ok() && matches(**run)) {
+        return **run;
+    }
+
+    // On a hash collision the new run is not cached.
+    u32 run = static_cast<u32>(record_geometry.length());
+    for(u64 g = begin; g < end; g++) {
+        record_geometry.push(g);
+    }
+    if(!record_runs.try_get(hash).ok()) record_runs.insert(hash, run);
+    return run;
+}
+
+template<typename CPU_Scene>
+void Scene::try_snapshot(Async::Pool<>& pool, const CPU_Scene& cpu) {
+
+    if(!progress || !config.progressive) return;
+    if(snapshot_task.ok() && !snapshot_task.done()) return;
+
+    Profile::Time_Point now = Profile::timestamp();
+    if(Profile::ms(now - last_snapshot) < config.snapshot_interval_ms) return;
+    last_snapshot = now;
+
+    Scene snapshot;
+    // Snapshots never stream, but their hit shaders still write texture feedback.
+    snapshot.config.shared_feedback = config.shared_feedback;
+    for(auto& reference : cpu_geometry_references) {
+        snapshot.cpu_geometry_references.push(reference);
+    }
+    for(u64 geometry : record_geometry) {
+        snapshot.record_geometry.push(geometry);
+    }
+
+    snapshot_task = publish_snapshot(pool, cpu, move(snapshot));
+}
+
+// A snapshot builds its own TLASes, geometry references, and materials over the BLASes and
+// geometry of this scene. No images are bound, so texture lookups fall back to constants.
+// Merging waits for the snapshot, so the traversal runs here rather than on the upload task.
+template<typename CPU_Scene>
+Async::Task<void> Scene::publish_snapshot(Async::Pool<>& pool, const CPU_Scene& cpu,
+                                          Scene snapshot) {
+    co_await pool.suspend();
+
+    using Material = If<Same<CPU_Scene, PBRT::Scene>, PBRT::Material, GLTF::Material>;
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    Traversal_Result traversal = co_await traverse(pool, cpu);
+
+    bool failed = false;
+
+    auto tlas_task = allocate_tlas(traversal.instances.slice())
+                         .match(Overload{
+                             [&](TLAS_Buffers buffers) {
+                                 return write_tlas_async(pool, move(buffers));
+                             },
+                             [&](auto) -> Async::Task<rvk::TLAS> {
+                                 failed = true;
+                                 co_return rvk::TLAS{};
+                             },
+                         });
+
+    auto emissive_tlas_task = allocate_tlas(traversal.emissive_instances.slice())
+                                  .match(Overload{
+                                      [&](TLAS_Buffers buffers) {
+                                          return write_tlas_async(pool, move(buffers));
+                                      },
+                                      [&](auto) -> Async::Task<rvk::TLAS> {
+                                          failed = true;
+                                          co_return rvk::TLAS{};
+                                      },
+                                  });
+
+    auto references_task =
+        allocate_geometry_references(snapshot.cpu_geometry_references.slice(),
+                                     Slice<const u64>{}, Slice<const u64>{})
+            .match(Overload{
+                [&](Geometry_Reference_Buffers buffers) {
+                    return write_geometry_references_async(pool, move(buffers));
                 },
-                [&](Device_Full) -> Async::Task<rvk::BLAS> {
-                    warn("BLAS too large for device heap.");
-                    co_return rvk::BLAS{};
+                [&](auto) -> Async::Task<rvk::Buffer> {
+                    failed = true;
+                    co_return rvk::Buffer{};
                 },
-            }));
-
-            auto geometry = allocate_geometry(refs.slice());
-            if(out_of_memory(geometry)) {
-                co_await await_all(blas_tasks, geom_tasks);
-                geometry = allocate_geometry(refs.slice());
-            }
+            });
 
-            geom_tasks.push(move(geometry).match(Overload{
-                [&](Geometry_Buffers buffers) { return write_geometry_async(pool, move(buffers)); },
-                [&](Staging_Full) -> Async::Task<Geometry_Result> {
-                    warn("Geometry too large for staging heap.");
-                    co_return Geometry_Result{};
+    auto materials_task =
+        allocate_materials(cpu.materials.slice(), Slice<const u64>{}, Slice<const u64>{})
+            .match(Overload{
+                [&](Materials_Buffers<Material> buffers) {
+                    return write_materials_async<CPU_Scene>(pool, cpu, move(buffers));
                 },
-                [&](Device_Full) -> Async::Task<Geometry_Result> {
-                    warn("Geometry too large for device heap.");
-                    co_return Geometry_Result{};
+                [&](auto) -> Async::Task<Shadowed_Upload> {
+                    failed = true;
+                    co_return Shadowed_Upload{};
                 },
-            }));
+            });
 
-            mesh_refs.push(move(refs));
+    snapshot.tlas = co_await tlas_task;
+    snapshot.emissive_tlas = co_await emissive_tlas_task;
+    snapshot.gpu_geometry_references = co_await references_task;
+    // Snapshots are not edited, so they drop the shadow.
+    snapshot.materials = move((co_await materials_task).device);
+
+    if(failed) {
+        warn("Out of memory, skipping scene snapshot.");
+        co_return;
+    }
+
+    snapshot.recreate_set();
+    progress->publish(move(snapshot));
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Published snapshot of % instances in % ms.", traversal.instances.length(),
+         Profile::ms(end - start));
+}
+
+static bool is_emissive(const PBRT::Scene& cpu, const PBRT::Object& object) {
+    for(auto& mesh : object.meshes) {
+        if(cpu.meshes[mesh.id].emission != Vec3{0.0f}) return true;
+    }
+    return false;
+}
+
+static bool is_emissive(const GLTF::Scene& cpu, const GLTF::Mesh& mesh) {
+    for(auto& prim : mesh.primitives) {
+        if(prim.material < 0) continue;
+        auto& material = cpu.materials[prim.material];
+        if(material.emissive_texture != -1 || material.emissive != Vec3{0.0f}) return true;
+    }
+    return false;
+}
+
+// Instancing an object costs a BLAS of its own plus a TLAS instance per use, while baking it into
+// the top level clusters costs its triangles once per use. Both costs are counted in triangles.
+static constexpr u64 BLAS_COST_TRIANGLES = 4096;
+static constexpr u64 INSTANCE_COST_TRIANGLES = 64;
+
+// Baking never adds more than this many duplicated triangles for one object.
+static constexpr u64 MAX_BAKED_TRIANGLES = 1 << 20;
+
+struct Bake_Plan {
+    Vec<bool, Alloc> baked;
+    u64 objects = 0;
+    u64 instances = 0;
+    u64 triangles = 0;
+};
+
+// Only leaf objects used directly by the top level can be baked, since their instance transforms
+// are known without flattening.
+static Bake_Plan plan_baking(const PBRT::Scene& cpu, const Config& config) {
+
+    u64 count = cpu.objects.length();
+
+    Bake_Plan plan;
+    plan.baked.resize(count);
+    if(!config.bake_objects) return plan;
+
+    Vec<u64, Alloc> uses;
+    Vec<bool, Alloc> nested;
+    uses.resize(count);
+    nested.resize(count);
+
+    for(auto& instance : cpu.top_level_instances) {
+        uses[instance.object.id]++;
+    }
+    for(auto& object : cpu.objects) {
+        for(auto& child : object.instances) nested[child.object.id] = true;
+    }
+
+    for(u64 i = 0; i < count; i++) {
+        auto& object = cpu.objects[i];
+        if(uses[i] == 0 || nested[i] || !object.instances.empty()) continue;
+
+        u64 triangles = 0;
+        for(auto mesh_id : object.meshes) {
+            triangles += cpu.meshes[mesh_id.id].indices.length() / 3;
         }
 
-        co_await await_all(blas_tasks, geom_tasks);
+        u64 instanced = BLAS_COST_TRIANGLES + triangles + uses[i] * INSTANCE_COST_TRIANGLES;
+        u64 flattened = triangles * uses[i];
+        if(flattened > instanced || flattened - triangles > MAX_BAKED_TRIANGLES) continue;
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % mesh BLASes in % ms.", cpu.meshes.length(), Profile::ms(end - start));
+        plan.baked[i] = true;
+        plan.objects++;
+        plan.instances += uses[i];
+        plan.triangles += flattened;
     }
 
-    Traversal_Result traversal;
-    {
+    return plan;
+}
+
+Async::Task<void> Scene::upload_blases(Async::Pool<>& pool, Upload_Budget& budget,
+                                       const PBRT::Scene& cpu) {
+    co_await pool.suspend();
+
+    Mesh_Pieces pieces;
+    Bake_Plan plan = plan_baking(cpu, config);
+
+    { // Top level BLASes
         Profile::Time_Point start = Profile::timestamp();
-        traversal = traverse(cpu);
+
+        Vec<Mesh_Ref, Alloc> non_emissive_meshes(cpu.top_level_meshes.length());
+        Vec<Mesh_Ref, Alloc> emissive_meshes(cpu.top_level_meshes.length());
+
+        auto add = [&](const Mesh_Ref& ref) {
+            if(!ref.check()) return;
+            if(cpu.meshes[ref.id].emission != Vec3{0.0f}) {
+                split_mesh(ref, config.max_blas_bytes, pieces, emissive_meshes);
+            } else {
+                split_mesh(ref, config.max_blas_bytes, pieces, non_emissive_meshes);
+            }
+        };
+
+        for(auto mesh_id : cpu.top_level_meshes) {
+            add(Mesh_Ref{cpu, mesh_id});
+        }
+
+        for(auto& instance : cpu.top_level_instances) {
+            if(!plan.baked[instance.object.id]) continue;
+            auto& object = cpu.objects[instance.object.id];
+            Mat4 instance_to_world = object.object_to_parent * instance.instance_to_object;
+            for(auto mesh_id : object.meshes) {
+                add(bake_mesh(Mesh_Ref{cpu, mesh_id}, instance_to_world, pieces));
+            }
+        }
+
+        Vec<Vec<Mesh_Ref, Alloc>, Alloc> clusters;
+        for(auto& cluster : cluster_meshes(non_emissive_meshes.slice())) {
+            split_object(cluster.slice(), config.max_blas_bytes, clusters);
+        }
+        top_level_first_emissive = clusters.length();
+        for(auto& cluster : cluster_meshes(emissive_meshes.slice())) {
+            split_object(cluster.slice(), config.max_blas_bytes, clusters);
+        }
+        top_level_blases = clusters.length();
+
+        Vec<Async::Task<Batch_Result>, Alloc> batches(clusters.length());
+        u64 merged = 0;
+
+        // Clusters are large enough to be uploaded as batches of their own.
+        for(auto& cluster : clusters) {
+            Object_Batcher batcher;
+            batcher.add(cluster.slice());
+            co_await enqueue(pool, budget, config, batches, batcher);
+            co_await merge_batches(pool, cpu, batches, merged, false);
+        }
+
+        co_await merge_batches(pool, cpu, batches, merged, true);
+
         Profile::Time_Point end = Profile::timestamp();
-        info("Traversed scene in % ms.", Profile::ms(end - start));
+        info("Built % top level BLASes (% emissive) for % meshes in % ms.", top_level_blases,
+             top_level_blases - top_level_first_emissive, cpu.top_level_meshes.length(),
+             Profile::ms(end - start));
+        info("Baked % of % objects (% instances, % triangles) into the top level BLASes.",
+             plan.objects, cpu.objects.length(), plan.instances, plan.triangles);
     }
 
-    { // Phase 2: TLAS (depends on BLASes)
+    { // Instance BLASes
         Profile::Time_Point start = Profile::timestamp();
 
-        auto tlas_task =
-            allocate_tlas(traversal.instances.slice())
-                .match(Overload{
-                    [&](TLAS_Buffers buffers) { return write_tlas_async(pool, move(buffers)); },
-                    [&](Staging_Full) -> Async::Task<rvk::TLAS> {
-                        warn("TLAS too large for staging heap.");
-                        co_return rvk::TLAS{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::TLAS> {
-                        warn("TLAS too large for device heap.");
-                        co_return rvk::TLAS{};
-                    },
-                });
-
-        auto emissive_tlas_task =
-            allocate_tlas(traversal.emissive_instances.slice())
-                .match(Overload{
-                    [&](TLAS_Buffers buffers) { return write_tlas_async(pool, move(buffers)); },
-                    [&](Staging_Full) -> Async::Task<rvk::TLAS> {
-                        warn("Emissive TLAS too large for staging heap.");
-                        co_return rvk::TLAS{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::TLAS> {
-                        warn("Emissive TLAS too large for device heap.");
-                        co_return rvk::TLAS{};
-                    },
-                });
-
-        tlas = co_await tlas_task;
-        emissive_tlas = co_await emissive_tlas_task;
+        Vec<Async::Task<Batch_Result>, Alloc> batches;
+        Object_Batcher batcher;
+        u64 merged = 0;
+
+        u64 mesh_count = 0;
+
+        // Every object is split before the first batch is enqueued, so snapshots traverse a
+        // complete object_parts while the batches merge.
+        Vec<Vec<Mesh_Ref, Alloc>, Alloc> parts;
+        object_parts = Vec<u64, Alloc>(cpu.objects.length() + 1);
+        object_parts.push(top_level_blases);
+        object_emissive = Vec<bool, Alloc>(cpu.objects.length());
+
+        for(u64 obj_idx = 0; obj_idx < cpu.objects.length(); obj_idx++) {
+
+            auto& obj = cpu.objects[obj_idx];
+
+            // Baked objects keep an empty range of parts, so traversal skips them.
+            if(plan.baked[obj_idx]) {
+                object_parts.push(object_parts[obj_idx]);
+                object_emissive.push(false);
+                continue;
+            }
+
+            Vec<Mesh_Ref, Alloc> refs(obj.meshes.length());
+            for(auto mesh_id : obj.meshes) {
+                split_mesh(Mesh_Ref{cpu, mesh_id}, config.max_blas_bytes, pieces, refs);
+                mesh_count++;
+            }
+
+            split_object(refs.slice(), config.max_blas_bytes, parts);
+            object_parts.push(top_level_blases + parts.length());
+            object_emissive.push(is_emissive(cpu, obj));
+        }
+
+        for(auto& part : parts) {
+            if(batcher.full_with(part.slice())) {
+                co_await enqueue(pool, budget, config, batches, batcher);
+                co_await merge_batches(pool, cpu, batches, merged, false);
+            }
+            batcher.add(part.slice());
+        }
+
+        co_await enqueue(pool, budget, config, batches, batcher);
+        co_await merge_batches(pool, cpu, batches, merged, true);
 
         Profile::Time_Point end = Profile::timestamp();
-        info("Built TLASes from % instances (% emissive) in % ms.", traversal.instances.length(),
-             traversal.emissive_instances.length(), Profile::ms(end - start));
+        info("Built % instance BLASes for % objects with % meshes in % ms.",
+             object_parts[cpu.objects.length()] - top_level_blases, cpu.objects.length(),
+             mesh_count, Profile::ms(end - start));
     }
+}
 
-    { // Phase 3: textures
-        Profile::Time_Point start = Profile::timestamp();
+Async::Task<void> Scene::upload_textures(Async::Pool<>& pool, Upload_Budget& budget,
+                                         const PBRT::Scene& cpu) {
+    co_await pool.suspend();
 
-        Vec<Async::Task<GPU_Image>, Alloc> image_tasks(parallelism);
+    Profile::Time_Point start = Profile::timestamp();
 
-        for(u64 tex_idx = 0; tex_idx < cpu.textures.length(); tex_idx++) {
+    Vec<Async::Task<GPU_Image>, Alloc> image_tasks(cpu.textures.length());
 
-            auto& tex = cpu.textures[tex_idx];
+    u64 image_count = 0;
+    auto sources =
+        image_sources(cpu.textures.slice(), config.compress_textures, config.hdr_format);
+    auto reductions = plan_reductions(sources.slice(), config.texture_budget);
+    log_reductions(reductions.slice());
 
-            { // Find sampler
-                auto config = sampler_config(tex);
-                if(auto sampler_idx = sampler_configs.try_get(config); sampler_idx.ok()) {
-                    texture_to_sampler_index.push(**sampler_idx);
-                } else {
-                    u64 idx = samplers.length();
-                    texture_to_sampler_index.push(idx);
-                    sampler_configs.insert(config, idx);
-                    samplers.push(rvk::make_sampler(config));
-                }
-            }
+    // First sampler is for environment map
+    {
+        rvk::Sampler::Config config{
+            .min = VK_FILTER_LINEAR,
+            .mag = VK_FILTER_LINEAR,
+            .u = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .v = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .w = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        };
+        sampler_configs.insert(config, 0);
+        samplers.push(rvk::make_sampler(config));
+    }
+
+    for(u64 tex_idx = 0; tex_idx < cpu.textures.length(); tex_idx++) {
 
-            { // Find image
-                texture_to_image_index.push(tex_idx);
+        auto& tex = cpu.textures[tex_idx];
+
+        { // Find sampler
+            auto config = sampler_config(tex);
+            if(auto sampler_idx = sampler_configs.try_get(config); sampler_idx.ok()) {
+                texture_to_sampler_index.push(**sampler_idx);
+            } else {
+                u64 idx = samplers.length();
+                texture_to_sampler_index.push(idx);
+                sampler_configs.insert(config, idx);
+                samplers.push(rvk::make_sampler(config));
             }
+        }
 
-            if(image_tasks.full()) {
-                co_await await_all(image_tasks);
+        { // Find image
+            if(tex.type == PBRT::Textures::Type::imagemap) {
+                texture_to_image_index.push(image_count++);
+            } else {
+                texture_to_image_index.push(RPP_UINT64_MAX);
+                continue;
             }
+        }
+
+        u32 reduction = reductions[tex_idx];
+        if(config.stream_textures) {
+            streamed_images.push(stream_tail(sources[tex_idx], tex_idx, reduction, config));
+            reduction = streamed_images.back().resident;
+        }
+
+        auto cost = image_cost(sources[tex_idx], reduction);
+        co_await budget.acquire(pool, cost);
+        image_tasks.push(upload_image(pool, budget, tex, sources[tex_idx].clone(), reduction,
+                                      config.hdr_format, config.texture_cache, cost));
+    }
+
+    co_await await_all(image_tasks);
+
+    if(image_count >= MAX_IMAGES) {
+        warn("Too many images, only the first % of % will be present.", MAX_IMAGES,
+             image_count);
+    }
+    if(samplers.length() >= MAX_SAMPLERS) {
+        warn("Too many samplers, only the first % of % will be present.", MAX_SAMPLERS,
+             samplers.length());
+    }
 
-            auto image = allocate_image(tex);
-            if(out_of_memory(image)) {
-                co_await await_all(image_tasks);
-                image = allocate_image(tex);
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built % images from % textures in % ms.", image_count, cpu.textures.length(),
+         Profile::ms(end - start));
+}
+
+Async::Task<void> Scene::upload_lights(Async::Pool<>& pool, Upload_Budget& budget,
+                                       const PBRT::Scene& cpu) {
+    co_await pool.suspend();
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    Vec<Pair<Mat4, u32>, Alloc> t_lights(cpu.lights.length());
+    for(u32 i = 0; i < cpu.lights.length(); i++) {
+        if(cpu.lights[i].type == PBRT::Lights::Type::infinite) {
+            if(environment_map.image) {
+                warn("Multiple environment maps detected, only the first one will be used.");
+                continue;
             }
+            auto image_task = allocate_envmap(cpu.lights[i], config.hdr_format)
+                                  .match(Overload{
+                                      [&](Image_Buffers buffers) {
+                                          return write_image_async(pool, budget.staging,
+                                                                   move(buffers));
+                                      },
+                                      [&](Staging_Full) -> Async::Task<GPU_Image> {
+                                          warn("Envmap too large for staging heap.");
+                                          co_return GPU_Image{};
+                                      },
+                                      [&](Device_Full) -> Async::Task<GPU_Image> {
+                                          warn("Envmap too large for device heap.");
+                                          co_return GPU_Image{};
+                                      },
+                                  });
+            environment_map = co_await image_task;
+        } else {
+            t_lights.push(Pair{Mat4::I, i});
+        }
+    }
 
-            image_tasks.push(move(image).match(Overload{
-                [&](Image_Buffers buffers) { return write_image_async(pool, move(buffers)); },
-                [&](Staging_Full) -> Async::Task<GPU_Image> {
-                    warn("Image too large for staging heap.");
-                    co_return GPU_Image{};
+    auto lights_task =
+        allocate_lights<PBRT::Light>(t_lights.slice())
+            .match(Overload{
+                [&](Lights_Buffers<PBRT::Light> buffers) {
+                    return write_lights_async<PBRT::Scene>(pool, cpu, move(buffers));
                 },
-                [&](Device_Full) -> Async::Task<GPU_Image> {
-                    warn("Image too large for device heap.");
-                    co_return GPU_Image{};
+                [&](Staging_Full) -> Async::Task<Shadowed_Upload> {
+                    warn("Lights too large for staging heap.");
+                    co_return Shadowed_Upload{};
                 },
-            }));
+                [&](Device_Full) -> Async::Task<Shadowed_Upload> {
+                    warn("Lights too large for device heap.");
+                    co_return Shadowed_Upload{};
+                },
+            });
+
+    auto upload = co_await lights_task;
+    lights = move(upload.device);
+    light_shadow.keep(move(upload.shadow), t_lights.length());
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built % lights in % ms.", cpu.lights.length(), Profile::ms(end - start));
+}
+
+Async::Task<void> Scene::upload_blases(Async::Pool<>& pool, Upload_Budget& budget,
+                                       const GLTF::Scene& cpu) {
+    co_await pool.suspend();
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    Vec<Async::Task<Batch_Result>, Alloc> batches;
+    Object_Batcher batcher;
+    Mesh_Pieces pieces;
+    u64 merged = 0;
+
+    // Every mesh is split before the first batch is enqueued, so snapshots traverse a complete
+    // object_parts while the batches merge.
+    Vec<Vec<Mesh_Ref, Alloc>, Alloc> parts;
+    object_parts = Vec<u64, Alloc>(cpu.meshes.length() + 1);
+    object_parts.push(0);
+    object_emissive = Vec<bool, Alloc>(cpu.meshes.length());
+
+    for(u64 mesh_idx = 0; mesh_idx < cpu.meshes.length(); mesh_idx++) {
+
+        auto& mesh = cpu.meshes[mesh_idx];
+        Vec<Mesh_Ref, Alloc> refs(mesh.primitives.length());
+        for(auto& prim : mesh.primitives) {
+            split_mesh(Mesh_Ref{cpu, prim, mesh_idx}, config.max_blas_bytes, pieces, refs);
         }
 
-        co_await await_all(image_tasks);
+        split_object(refs.slice(), config.max_blas_bytes, parts);
+        object_parts.push(parts.length());
+        object_emissive.push(is_emissive(cpu, mesh));
+    }
 
-        if(cpu.textures.length() >= MAX_IMAGES) {
-            warn("Too many images, only the first % of % will be present.", MAX_IMAGES,
-                 cpu.textures.length());
+    for(auto& part : parts) {
+        if(batcher.full_with(part.slice())) {
+            co_await enqueue(pool, budget, config, batches, batcher);
+            co_await merge_batches(pool, cpu, batches, merged, false);
         }
-        if(samplers.length() >= MAX_SAMPLERS) {
-            warn("Too many samplers, only the first % of % will be present.", MAX_SAMPLERS,
-                 samplers.length());
+        batcher.add(part.slice());
+    }
+
+    co_await enqueue(pool, budget, config, batches, batcher);
+    co_await merge_batches(pool, cpu, batches, merged, true);
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built % BLASes for % meshes in % ms.", object_parts[cpu.meshes.length()],
+         cpu.meshes.length(), Profile::ms(end - start));
+}
+
+Async::Task<void> Scene::upload_textures(Async::Pool<>& pool, Upload_Budget& budget,
+                                         const GLTF::Scene& cpu) {
+    co_await pool.suspend();
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    Vec<Async::Task<GPU_Image>, Alloc> image_tasks(cpu.textures.length());
+
+    auto sources =
+        image_sources(cpu.textures.slice(), config.compress_textures, config.hdr_format);
+    auto reductions = plan_reductions(sources.slice(), config.texture_budget);
+    log_reductions(reductions.slice());
+
+    for(u64 tex_idx = 0; tex_idx < cpu.textures.length(); tex_idx++) {
+
+        auto& tex = cpu.textures[tex_idx];
+
+        { // Find sampler
+            auto config = sampler_config(tex);
+            if(auto sampler_idx = sampler_configs.try_get(config); sampler_idx.ok()) {
+                texture_to_sampler_index.push(**sampler_idx);
+            } else {
+                u64 idx = samplers.length();
+                texture_to_sampler_index.push(idx);
+                sampler_configs.insert(config, idx);
+                samplers.push(rvk::make_sampler(config));
+            }
         }
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % textures in % ms.", cpu.textures.length(), Profile::ms(end - start));
-    }
+        { // Find image
+            texture_to_image_index.push(tex_idx);
+        }
 
-    { // Phase 4: geometry references (depends on BLASes & textures)
-        Profile::Time_Point start = Profile::timestamp();
+        u32 reduction = reductions[tex_idx];
+        if(config.stream_textures) {
+            streamed_images.push(stream_tail(sources[tex_idx], tex_idx, reduction, config));
+            reduction = streamed_images.back().resident;
+        }
 
-        auto geom_ref_task =
-            allocate_geometry_references(cpu_geometry_references.slice(),
-                                         texture_to_image_index.slice(),
-                                         texture_to_sampler_index.slice())
-                .match(Overload{
-                    [&](Geometry_Reference_Buffers buffers) {
-                        return write_geometry_references_async(pool, move(buffers));
-                    },
-                    [&](Staging_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Geometry references too large for staging heap.");
-                        co_return rvk::Buffer{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Geometry references too large for device heap.");
-                        co_return rvk::Buffer{};
-                    },
-                });
-
-        gpu_geometry_references = co_await geom_ref_task;
+        auto cost = image_cost(sources[tex_idx], reduction);
+        co_await budget.acquire(pool, cost);
+        image_tasks.push(upload_image(pool, budget, tex, sources[tex_idx].clone(), reduction,
+                                      config.hdr_format, config.texture_cache, cost));
+    }
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % geometry references in % ms.", cpu_geometry_references.length(),
-             Profile::ms(end - start));
+    co_await await_all(image_tasks);
+
+    if(cpu.textures.length() >= MAX_IMAGES) {
+        warn("Too many images, only the first % of % will be present.", MAX_IMAGES,
+             cpu.textures.length());
+    }
+    if(samplers.length() >= MAX_SAMPLERS) {
+        warn("Too many samplers, only the first % of % will be present.", MAX_SAMPLERS,
+             samplers.length());
     }
 
-    { // Phase 5: materials (depends on textures)
-        Profile::Time_Point start = Profile::timestamp();
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built % textures in % ms.", cpu.textures.length(), Profile::ms(end - start));
+}
 
-        auto materials_task =
-            allocate_materials(cpu.materials.slice(), texture_to_image_index.slice(),
-                               texture_to_sampler_index.slice())
-                .match(Overload{
-                    [&](Materials_Buffers<GLTF::Material> buffers) {
-                        return write_materials_async<GLTF::Scene>(pool, cpu, move(buffers));
-                    },
-                    [&](Staging_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Materials too large for staging heap.");
-                        co_return rvk::Buffer{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Materials too large for device heap.");
-                        co_return rvk::Buffer{};
-                    },
-                });
-
-        materials = co_await materials_task;
+Async::Task<void> Scene::upload_lights(Async::Pool<>& pool, const GLTF::Scene& cpu,
+                                       const Traversal_Result& traversal) {
+    co_await pool.suspend();
 
-        Profile::Time_Point end = Profile::timestamp();
-        info("Built % materials in % ms.", cpu.materials.length(), Profile::ms(end - start));
-    }
+    Profile::Time_Point start = Profile::timestamp();
 
-    { // Phase 6: lights
-        Profile::Time_Point start = Profile::timestamp();
+    auto lights_task =
+        allocate_lights<GLTF::Light>(traversal.gltf_lights.slice())
+            .match(Overload{
+                [&](Lights_Buffers<GLTF::Light> buffers) {
+                    return write_lights_async<GLTF::Scene>(pool, cpu, move(buffers));
+                },
+                [&](Staging_Full) -> Async::Task<Shadowed_Upload> {
+                    warn("Lights too large for staging heap.");
+                    co_return Shadowed_Upload{};
+                },
+                [&](Device_Full) -> Async::Task<Shadowed_Upload> {
+                    warn("Lights too large for device heap.");
+                    co_return Shadowed_Upload{};
+                },
+            });
+
+    auto upload = co_await lights_task;
+    lights = move(upload.device);
+    light_shadow.keep(move(upload.shadow), traversal.gltf_lights.length());
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built % lights in % ms.", cpu.lights.length(), Profile::ms(end - start));
+}
+
+Async::Task<void> Scene::upload_tlases(Async::Pool<>& pool, const Traversal_Result& traversal) {
+    co_await pool.suspend();
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    auto tlas_task =
+        allocate_tlas(traversal.instances.slice())
+            .match(Overload{
+                [&](TLAS_Buffers buffers) { return write_tlas_async(pool, move(buffers)); },
+                [&](Staging_Full) -> Async::Task<rvk::TLAS> {
+                    warn("TLAS too large for staging heap.");
+                    co_return rvk::TLAS{};
+                },
+                [&](Device_Full) -> Async::Task<rvk::TLAS> {
+                    warn("TLAS too large for device heap.");
+                    co_return rvk::TLAS{};
+                },
+            });
+
+    auto emissive_tlas_task =
+        allocate_tlas(traversal.emissive_instances.slice())
+            .match(Overload{
+                [&](TLAS_Buffers buffers) { return write_tlas_async(pool, move(buffers)); },
+                [&](Staging_Full) -> Async::Task<rvk::TLAS> {
+                    warn("Emissive TLAS too large for staging heap.");
+                    co_return rvk::TLAS{};
+                },
+                [&](Device_Full) -> Async::Task<rvk::TLAS> {
+                    warn("Emissive TLAS too large for device heap.");
+                    co_return rvk::TLAS{};
+                },
+            });
+
+    tlas = co_await tlas_task;
+    emissive_tlas = co_await emissive_tlas_task;
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built TLASes from % instances (% emissive) in % ms.", traversal.instances.length(),
+         traversal.emissive_instances.length(), Profile::ms(end - start));
+}
+
+Async::Task<void> Scene::upload_geometry_references(Async::Pool<>& pool) {
+    co_await pool.suspend();
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    auto geom_ref_task =
+        allocate_geometry_references(cpu_geometry_references.slice(),
+                                     texture_to_image_index.slice(),
+                                     texture_to_sampler_index.slice())
+            .match(Overload{
+                [&](Geometry_Reference_Buffers buffers) {
+                    return write_geometry_references_async(pool, move(buffers));
+                },
+                [&](Staging_Full) -> Async::Task<rvk::Buffer> {
+                    warn("Geometry references too large for staging heap.");
+                    co_return rvk::Buffer{};
+                },
+                [&](Device_Full) -> Async::Task<rvk::Buffer> {
+                    warn("Geometry references too large for device heap.");
+                    co_return rvk::Buffer{};
+                },
+            });
 
-        auto lights_task =
-            allocate_lights<GLTF::Light>(traversal.gltf_lights.slice())
-                .match(Overload{
-                    [&](Lights_Buffers<GLTF::Light> buffers) {
-                        return write_lights_async<GLTF::Scene>(pool, cpu, move(buffers));
-                    },
-                    [&](Staging_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Lights too large for staging heap.");
-                        co_return rvk::Buffer{};
-                    },
-                    [&](Device_Full) -> Async::Task<rvk::Buffer> {
-                        warn("Lights too large for device heap.");
-                        co_return rvk::Buffer{};
-                    },
-                });
-
-        lights = co_await lights_task;
+    gpu_geometry_references = co_await geom_ref_task;
 
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built % geometry references in % ms.", cpu_geometry_references.length(),
+         Profile::ms(end - start));
+}
+
+template<typename CPU_Scene>
+Async::Task<void> Scene::upload_materials(Async::Pool<>& pool, const CPU_Scene& cpu) {
+    co_await pool.suspend();
+
+    using Material = If<Same<CPU_Scene, PBRT::Scene>, PBRT::Material, GLTF::Material>;
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    auto materials_task =
+        allocate_materials(cpu.materials.slice(), texture_to_image_index.slice(),
+                           texture_to_sampler_index.slice())
+            .match(Overload{
+                [&](Materials_Buffers<Material> buffers) {
+                    return write_materials_async<CPU_Scene>(pool, cpu, move(buffers));
+                },
+                [&](Staging_Full) -> Async::Task<Shadowed_Upload> {
+                    warn("Materials too large for staging heap.");
+                    co_return Shadowed_Upload{};
+                },
+                [&](Device_Full) -> Async::Task<Shadowed_Upload> {
+                    warn("Materials too large for device heap.");
+                    co_return Shadowed_Upload{};
+                },
+            });
+
+    auto upload = co_await materials_task;
+    materials = move(upload.device);
+    material_shadow.keep(move(upload.shadow), cpu.materials.length());
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Built % materials in % ms.", cpu.materials.length(), Profile::ms(end - start));
+}
+
+Async::Task<void> Scene::upload(Async::Pool<>& pool, const PBRT::Scene& cpu) {
+    co_await pool.suspend();
+
+    Profile::Time_Point start = Profile::timestamp();
+
+    Upload_Budget budget{config};
+
+    // Textures and lights do not depend on any BLAS, so they stream in while the BLASes build.
+    auto textures_task = upload_textures(pool, budget, cpu);
+    auto lights_task = upload_lights(pool, budget, cpu);
+
+    co_await upload_blases(pool, budget, cpu);
+
+    Traversal_Result traversal;
+    {
+        Profile::Time_Point start = Profile::timestamp();
+        traversal = co_await traverse(pool, cpu);
         Profile::Time_Point end = Profile::timestamp();
-        info("Built % lights in % ms.", cpu.lights.length(), Profile::ms(end - start));
+        info("Traversed scene in % ms.", Profile::ms(end - start));
     }
 
+    auto tlases_task = upload_tlases(pool, traversal);
+
+    // Geometry references and materials point into the image array.
+    co_await textures_task;
+
+    auto references_task = upload_geometry_references(pool);
+    auto materials_task = upload_materials(pool, cpu);
+
+    co_await tlases_task;
+    co_await references_task;
+    co_await materials_task;
+    co_await lights_task;
+
     recreate_set();
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Uploaded scene in % ms.", Profile::ms(end - start));
 }
 
-void Scene::traverse(Scene::Traversal_Result& out, const PBRT::Scene& cpu,
-                     const PBRT::Instance& instance, Mat4 parent_to_world) {
+Async::Task<void> Scene::upload(Async::Pool<>& pool, const GLTF::Scene& cpu) {
+    co_await pool.suspend();
 
-    auto& object = cpu.objects[instance.object.id];
+    Profile::Time_Point start = Profile::timestamp();
 
-    Mat4 instance_to_world =
-        parent_to_world * object.object_to_parent * instance.instance_to_object;
+    Upload_Budget budget{config};
 
-    if(auto& blas = object_blases[instance.object.id + 2]) {
-        u32 geometry_index = static_cast<u32>(object_to_geometry_index[instance.object.id + 2]);
-        rvk::TLAS::Instance t_instance{
-            .transform = to_transform(instance_to_world),
-            .instanceCustomIndex = geometry_index,
-            .mask = 0xff,
-            .instanceShaderBindingTableRecordOffset = geometry_index,
-            .flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
-            .accelerationStructureReference = blas.gpu_address(),
-        };
-        out.instances.push(t_instance);
+    // Textures do not depend on any BLAS, so they stream in while the BLASes build.
+    auto textures_task = upload_textures(pool, budget, cpu);
 
-        bool is_emissive = false;
-        for(auto& mesh : object.meshes) {
-            if(cpu.meshes[mesh.id].emission != Vec3{0.0f}) {
-                is_emissive = true;
-                break;
-            }
-        }
+    co_await upload_blases(pool, budget, cpu);
 
-        if(is_emissive) {
-            out.emissive_instances.push(t_instance);
-        }
+    Traversal_Result traversal;
+    {
+        Profile::Time_Point start = Profile::timestamp();
+        traversal = co_await traverse(pool, cpu);
+        Profile::Time_Point end = Profile::timestamp();
+        info("Traversed scene in % ms.", Profile::ms(end - start));
     }
 
-    for(auto& child : object.instances) {
-        traverse(out, cpu, child, instance_to_world);
-    }
+    auto tlases_task = upload_tlases(pool, traversal);
+    auto lights_task = upload_lights(pool, cpu, traversal);
+
+    // Geometry references and materials point into the image array.
+    co_await textures_task;
+
+    auto references_task = upload_geometry_references(pool);
+    auto materials_task = upload_materials(pool, cpu);
+
+    co_await tlases_task;
+    co_await references_task;
+    co_await materials_task;
+    co_await lights_task;
+
+    recreate_set();
+
+    Profile::Time_Point end = Profile::timestamp();
+    info("Uploaded scene in % ms.", Profile::ms(end - start));
 }
 
-Scene::Traversal_Result Scene::traverse(const PBRT::Scene& cpu) {
+// A run of sibling subtrees with at least this many TLAS instances is flattened by its own task.
+static constexpr u64 FLATTEN_TASK_INSTANCES = 1 << 14;
 
-    Profile::Time_Point start = Profile::timestamp();
+struct Flatten_Count {
+    u64 instances = 0;
+    u64 emissive = 0;
+    u64 lights = 0;
 
-    Mat4 to_camera = Mat4::swap_x_z * cpu.camera.world_to_camera;
+    Flatten_Count& operator+=(const Flatten_Count& other) {
+        instances += other.instances;
+        emissive += other.emissive;
+        lights += other.lights;
+        return *this;
+    }
+};
 
-    Scene::Traversal_Result result;
+// Flattens an instance hierarchy into TLAS instances. A counting pass sizes every subtree, so
+// runs of sibling subtrees can then be written in parallel into disjoint output ranges. The
+// instances come out in the same depth first order as a serial traversal.
+template<typename CPU_Scene>
+struct Flattener {
+
+    // PBRT instances refer to objects; glTF nodes refer to other nodes by index.
+    static constexpr bool is_pbrt = Same<CPU_Scene, PBRT::Scene>;
+    using Child = If<is_pbrt, PBRT::Instance, u32>;
+
+    Flattener(const CPU_Scene& cpu, Slice<const rvk::BLAS> blases, Slice<const u32> records,
+              Slice<const u64> parts, Slice<const u64> geometry, Slice<const bool> emissive)
+        : cpu(cpu), blases(blases), records(records), parts(parts), geometry(geometry),
+          emissive(emissive) {
+        if constexpr(is_pbrt) {
+            counts.resize(cpu.objects.length());
+            counted.resize(cpu.objects.length());
+        } else {
+            counts.resize(cpu.nodes.length());
+            counted.resize(cpu.nodes.length());
+        }
+    }
 
-    if(object_blases[0]) {
-        u32 geometry_index = static_cast<u32>(object_to_geometry_index[0]);
-        rvk::TLAS::Instance instance{
-            .transform = to_transform(to_camera),
-            .instanceCustomIndex = geometry_index,
-            .mask = 0xff,
-            .instanceShaderBindingTableRecordOffset = geometry_index,
-            .flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
-            .accelerationStructureReference = object_blases[0].gpu_address(),
-        };
-        result.instances.push(instance);
+    // Snapshots flatten while later BLASes are still uploading.
+    bool present(u64 blas) const {
+        return blas < blases.length() && blases[blas];
     }
-    if(object_blases[1]) {
-        u32 geometry_index = static_cast<u32>(object_to_geometry_index[1]);
-        rvk::TLAS::Instance instance{
-            .transform = to_transform(to_camera),
+
+    rvk::TLAS::Instance instance(u64 blas, VkTransformMatrixKHR transform) const {
+        u32 geometry_index = static_cast<u32>(geometry[blas]);
+        return rvk::TLAS::Instance{
+            .transform = transform,
             .instanceCustomIndex = geometry_index,
             .mask = 0xff,
-            .instanceShaderBindingTableRecordOffset = geometry_index,
+            .instanceShaderBindingTableRecordOffset = records[blas],
             .flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
-            .accelerationStructureReference = object_blases[1].gpu_address(),
+            .accelerationStructureReference = blases[blas].gpu_address(),
         };
-        result.instances.push(instance);
-        result.emissive_instances.push(instance);
     }
 
-    for(auto& instance : cpu.top_level_instances) {
-        traverse(result, cpu, instance, to_camera);
+    Flatten_Count count(const Child& child) {
+        u64 node = index(child);
+        if(counted[node]) return counts[node];
+
+        Flatten_Count ret = count_parts(object(node));
+        if(light(node) >= 0) ret.lights++;
+        for(auto& grandchild : children(node)) ret += count(grandchild);
+
+        counted[node] = true;
+        counts[node] = ret;
+        return ret;
     }
 
-    Profile::Time_Point end = Profile::timestamp();
-    info("Traversed scene in % ms.", Profile::ms(end - start));
+    static Async::Task<void> flatten(Async::Pool<>& pool, const Flattener& self,
+                                     Slice<const Child> range, Mat4 parent_to_world,
+                                     Flatten_Count cursor) {
+        co_await pool.suspend();
 
-    return result;
-}
+        Vec<Async::Task<void>, Alloc> tasks;
+        for(auto& child : range) {
+            self.write(pool, tasks, child, parent_to_world, cursor);
+        }
+        for(auto& task : tasks) {
+            co_await task;
+        }
+    }
 
-void Scene::traverse(Scene::Traversal_Result& out, const GLTF::Scene& cpu, const GLTF::Node& node,
-                     Mat4 parent_to_world) {
+    Slice<rvk::TLAS::Instance> instances;
+    Slice<rvk::TLAS::Instance> emissive_instances;
+    Slice<Pair<Mat4, u32>> lights;
 
-    Mat4 instance_to_world = parent_to_world * node.node_to_parent;
+private:
+    static u64 index(const Child& child) {
+        if constexpr(is_pbrt) {
+            return child.object.id;
+        } else {
+            return child;
+        }
+    }
 
-    if(node.light >= 0) {
-        out.gltf_lights.push(Pair{instance_to_world, static_cast<u32>(node.light)});
+    i64 object(u64 node) const {
+        if constexpr(is_pbrt) {
+            return static_cast<i64>(node);
+        } else {
+            return cpu.nodes[node].mesh;
+        }
     }
 
-    if(node.mesh >= 0) {
-        if(auto& blas = object_blases[node.mesh]) {
-            u32 geometry_index = static_cast<u32>(object_to_geometry_index[node.mesh]);
-            rvk::TLAS::Instance instance{
-                .transform = to_transform(instance_to_world),
-                .instanceCustomIndex = geometry_index,
-                .mask = 0xff,
-                .instanceShaderBindingTableRecordOffset = geometry_index,
-                .flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR,
-                .accelerationStructureReference = blas.gpu_address(),
-            };
+    i32 light(u64 node) const {
+        if constexpr(is_pbrt) {
+            return -1;
+        } else {
+            return cpu.nodes[node].light;
+        }
+    }
 
-            out.instances.push(instance);
+    Slice<const Child> children(u64 node) const {
+        if constexpr(is_pbrt) {
+            return cpu.objects[node].instances.slice();
+        } else {
+            return cpu.nodes[node].children.slice();
+        }
+    }
 
-            bool is_emissive = false;
-            if(node.mesh >= 0) {
-                auto& mesh = cpu.meshes[node.mesh];
-                for(auto& prim : mesh.primitives) {
-                    if(prim.material >= 0) {
-                        auto& material = cpu.materials[prim.material];
-                        if(material.emissive_texture != -1 || material.emissive != Vec3{0.0f}) {
-                            is_emissive = true;
-                            break;
-                        }
-                    }
-                }
-            }
+    Mat4 child_to_parent(const Child& child) const {
+        if constexpr(is_pbrt) {
+            return cpu.objects[child.object.id].object_to_parent * child.instance_to_object;
+        } else {
+            return cpu.nodes[child].node_to_parent;
+        }
+    }
 
-            if(is_emissive) {
-                out.emissive_instances.push(instance);
+    // Objects whose parts have not been split yet have no instances.
+    Slice<const u64> object_parts(i64 object) const {
+        if(object < 0 || static_cast<u64>(object) + 1 >= parts.length()) return {};
+        return Slice<const u64>{parts.data() + object, 2};
+    }
+
+    bool object_emissive(i64 object) const {
+        return object >= 0 && static_cast<u64>(object) < emissive.length() && emissive[object];
+    }
+
+    Flatten_Count count_parts(i64 object) const {
+        Flatten_Count ret;
+        auto range = object_parts(object);
+        if(range.empty()) return ret;
+        for(u64 i = range[0]; i < range[1]; i++) {
+            if(present(i)) ret.instances++;
+        }
+        if(object_emissive(object)) ret.emissive = ret.instances;
+        return ret;
+    }
+
+    void write(Async::Pool<>& pool, Vec<Async::Task<void>, Alloc>& tasks, const Child& child,
+               Mat4 parent_to_world, Flatten_Count& cursor) const {
+
+        u64 node = index(child);
+        Mat4 child_to_world = parent_to_world * child_to_parent(child);
+
+        if(i32 l = light(node); l >= 0) {
+            lights[cursor.lights++] = Pair{child_to_world, static_cast<u32>(l)};
+        }
+
+        i64 obj = object(node);
+        auto range = object_parts(obj);
+        if(!range.empty()) {
+            bool emits = object_emissive(obj);
+            auto transform = to_transform(child_to_world);
+            for(u64 i = range[0]; i < range[1]; i++) {
+                if(!present(i)) continue;
+                auto t_instance = instance(i, transform);
+                instances[cursor.instances++] = t_instance;
+                if(emits) emissive_instances[cursor.emissive++] = t_instance;
             }
         }
+
+        write_children(pool, tasks, children(node), child_to_world, cursor);
     }
 
-    for(auto& child : node.children) {
-        traverse(out, cpu, cpu.nodes[child], instance_to_world);
+    void write_children(Async::Pool<>& pool, Vec<Async::Task<void>, Alloc>& tasks,
+                        Slice<const Child> siblings, Mat4 parent_to_world,
+                        Flatten_Count& cursor) const {
+
+        // Small subtrees are written inline; runs of them large enough are handed to a task
+        // starting at the current cursor, which then skips past the run.
+        u64 begin = 0;
+        Flatten_Count run;
+        for(u64 i = 0; i < siblings.length(); i++) {
+            run += counts[index(siblings[i])];
+            bool last = i + 1 == siblings.length();
+            if(run.instances < FLATTEN_TASK_INSTANCES && !last) continue;
+
+            Slice<const Child> range{siblings.data() + begin, i + 1 - begin};
+            if(run.instances >= FLATTEN_TASK_INSTANCES) {
+                tasks.push(flatten(pool, *this, range, parent_to_world, cursor));
+                cursor += run;
+            } else {
+                for(auto& child : range) {
+                    write(pool, tasks, child, parent_to_world, cursor);
+                }
+            }
+            begin = i + 1;
+            run = {};
+        }
     }
-}
 
-Scene::Traversal_Result Scene::traverse(const GLTF::Scene& cpu) {
+    const CPU_Scene& cpu;
+    Slice<const rvk::BLAS> blases;
+    Slice<const u32> records;
+    Slice<const u64> parts;
+    Slice<const u64> geometry;
+    Slice<const bool> emissive;
 
-    Profile::Time_Point start = Profile::timestamp();
+    // Subtree sizes of each PBRT object or glTF node, filled in by count.
+    Vec<Flatten_Count, Alloc> counts;
+    Vec<bool, Alloc> counted;
+};
 
-    Traversal_Result result;
+template<typename CPU_Scene>
+Async::Task<Scene::Traversal_Result> Scene::traverse(Async::Pool<>& pool, const CPU_Scene& cpu) {
 
-    for(u32 node : cpu.top_level_nodes) {
-        traverse(result, cpu, cpu.nodes[node], Mat4::I);
+    using Child = typename Flattener<CPU_Scene>::Child;
+
+    Flattener<CPU_Scene> flattener{cpu, object_blases.slice(), blas_records.slice(),
+                                   object_parts.slice(), object_to_geometry_index.slice(),
+                                   object_emissive.slice()};
+
+    Mat4 root_to_world = Mat4::I;
+    Slice<const Child> roots;
+    Flatten_Count total;
+
+    if constexpr(Same<CPU_Scene, PBRT::Scene>) {
+        root_to_world = Mat4::swap_x_z * cpu.camera.world_to_camera;
+        roots = cpu.top_level_instances.slice();
+        for(u64 i = 0; i < top_level_blases; i++) {
+            if(!flattener.present(i)) continue;
+            total.instances++;
+            if(i >= top_level_first_emissive) total.emissive++;
+        }
+    } else {
+        roots = cpu.top_level_nodes.slice();
     }
 
-    Profile::Time_Point end = Profile::timestamp();
-    info("Traversed scene in % ms.", Profile::ms(end - start));
+    for(auto& root : roots) {
+        total += flattener.count(root);
+    }
 
-    return result;
+    Traversal_Result result;
+    result.instances.resize(total.instances);
+    result.emissive_instances.resize(total.emissive);
+    result.gltf_lights.resize(total.lights);
+
+    flattener.instances = result.instances.slice();
+    flattener.emissive_instances = result.emissive_instances.slice();
+    flattener.lights = result.gltf_lights.slice();
+
+    // The top level clusters come first, followed by the instance hierarchy.
+    Flatten_Count cursor;
+    if constexpr(Same<CPU_Scene, PBRT::Scene>) {
+        auto transform = to_transform(root_to_world);
+        for(u64 i = 0; i < top_level_blases; i++) {
+            if(!flattener.present(i)) continue;
+            auto instance = flattener.instance(i, transform);
+            result.instances[cursor.instances++] = instance;
+            if(i >= top_level_first_emissive) {
+                result.emissive_instances[cursor.emissive++] = instance;
+            }
+        }
+    }
+
+    co_await Flattener<CPU_Scene>::flatten(pool, flattener, roots, root_to_world, cursor);
+
+    co_return result;
 }
 
 rvk::Binding_Table Scene::table(Table_Type type, rvk::Commands& cmds, rvk::Pipeline& pipeline) {
@@ -1952,59 +3766,39 @@ rvk::Binding_Table Scene::table(Table_Type type, rvk::Commands& cmds, rvk::Pipel
     Profile::Time_Point start = Profile::timestamp();
     Opt<rvk::Binding_Table> table;
 
-    switch(type) {
-    case Table_Type::geometry_to_single: {
-        Region(R) {
-            Vec<u32, Mregion<R>> hit(cpu_geometry_references.length());
-            for(u32 i = 0; i < cpu_geometry_references.length(); i++) {
+    // Every table has one record per entry of record_geometry, since the TLAS instances select
+    // their records independently of the pipeline. Records are shared between geometries, so
+    // geometry_to_id tables cannot tell geometries apart by hit group. They use one hit group,
+    // whose shader reads the geometry id from the instance custom index plus the geometry index
+    // within the BLAS, as hit_info.hlsl does.
+    Region(R) {
+        Vec<u32, Mregion<R>> hit(record_geometry.length());
+        for(u64 geometry : record_geometry) {
+            switch(type) {
+            case Table_Type::geometry_to_single:
+            case Table_Type::geometry_to_id: {
                 hit.push(2u);
+            } break;
+            case Table_Type::geometry_to_material: {
+                hit.push(2u + static_cast<u32>(cpu_geometry_references[geometry].material_type));
+            } break;
+            default: RPP_UNREACHABLE;
             }
-            table = rvk::make_table(cmds, pipeline,
-                                    rvk::Binding_Table::Mapping{
-                                        .gen = Slice{0u},
-                                        .miss = Slice{1u},
-                                        .hit = hit.slice(),
-                                        .call = Slice<const u32>{},
-                                    });
-        }
-    } break;
-    case Table_Type::geometry_to_material: {
-        Region(R) {
-            Vec<u32, Mregion<R>> hit(cpu_geometry_references.length());
-            for(u32 i = 0; i < cpu_geometry_references.length(); i++) {
-                hit.push(2u + static_cast<u32>(cpu_geometry_references[i].material_type));
-            }
-            table = rvk::make_table(cmds, pipeline,
-                                    rvk::Binding_Table::Mapping{
-                                        .gen = Slice{0u},
-                                        .miss = Slice{1u},
-                                        .hit = hit.slice(),
-                                        .call = Slice<const u32>{},
-                                    });
-        }
-    } break;
-    case Table_Type::geometry_to_id: {
-        Region(R) {
-            Vec<u32, Mregion<R>> hit(cpu_geometry_references.length());
-            for(u32 i = 0; i < cpu_geometry_references.length(); i++) {
-                hit.push(2u + i);
-            }
-            table = rvk::make_table(cmds, pipeline,
-                                    rvk::Binding_Table::Mapping{
-                                        .gen = Slice{0u},
-                                        .miss = Slice{1u},
-                                        .hit = hit.slice(),
-                                        .call = Slice<const u32>{},
-                                    });
         }
-    } break;
-    default: RPP_UNREACHABLE;
+        table = rvk::make_table(cmds, pipeline,
+                                rvk::Binding_Table::Mapping{
+                                    .gen = Slice{0u},
+                                    .miss = Slice{1u},
+                                    .hit = hit.slice(),
+                                    .call = Slice<const u32>{},
+                                });
     }
 
     Profile::Time_Point end = Profile::timestamp();
 
     if(table.ok()) {
-        info("Created shader binding table in % ms.", Profile::ms(end - start));
+        info("Created shader binding table with % hit records in % ms.", record_geometry.length(),
+             Profile::ms(end - start));
         return move(*table);
     } else {
         warn("Failed to create % shader binding table.", type);
@@ -2039,11 +3833,15 @@ void Scene::recreate_set() {
         rvk::Bind::Image_Sampled<SCENE_STAGES> b4{environment_map.view};
         rvk::Bind::Image_Sampled_Array<SCENE_STAGES> b5{image_binds.slice()};
         rvk::Bind::Sampler_Array<SCENE_STAGES> b6{sampler_binds.slice()};
+        // The hit shaders write texture feedback whether or not the scene streams.
+        rvk::Buffer& feedback =
+            texture_feedback || !config.shared_feedback ? texture_feedback : *config.shared_feedback;
+        rvk::Bind::Buffer_Storage<SCENE_STAGES> b7{feedback};
 
         descriptor_set = rvk::make_set(descriptor_set_layout);
 
         for(u32 f = 0; f < rvk::frame_count(); f++) {
-            rvk::write_set<Layout>(descriptor_set, f, b0, b1, b2, b3, b4, b5, b6);
+            rvk::write_set<Layout>(descriptor_set, f, b0, b1, b2, b3, b4, b5, b6, b7);
         }
     }
 
@@ -2055,6 +3853,221 @@ bool Scene::has_environment_map() const {
     return environment_map.image;
 }
 
+template<typename T>
+void Shadow<T>::keep(rvk::Buffer staging, u64 length) {
+    buffer = move(staging);
+    elements = buffer ? Slice<T>{reinterpret_cast<T*>(buffer.map()), length} : Slice<T>{};
+}
+
+template<typename T>
+void Shadow<T>::edit(u64 i, const T& value) {
+    if(i >= elements.length()) return;
+
+    // Copies recorded by earlier frames may still be pending and read the new value instead,
+    // which the copy recorded by the next flush agrees with.
+    elements[i] = value;
+
+    if(!dirty.empty() && dirty.back().first <= i && i <= dirty.back().second) {
+        dirty.back().second = Math::max(dirty.back().second, i + 1);
+    } else {
+        dirty.push(Pair{i, i + 1});
+    }
+}
+
+template<typename T>
+bool Shadow<T>::flush(rvk::Commands& cmds, rvk::Buffer& device) {
+    if(dirty.empty()) return false;
+
+    Vec<VkBufferCopy, Alloc> regions(dirty.length());
+    for(auto& range : dirty) {
+        regions.push(VkBufferCopy{
+            .srcOffset = range.first * sizeof(T),
+            .dstOffset = range.first * sizeof(T),
+            .size = (range.second - range.first) * sizeof(T),
+        });
+    }
+    dirty.clear();
+
+    // Frames still in flight may read the old values; later frames read the new ones.
+    memory_barrier(cmds, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                   VK_ACCESS_2_SHADER_READ_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                   VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    vkCmdCopyBuffer(cmds, buffer, device, static_cast<u32>(regions.length()), regions.data());
+    memory_barrier(cmds, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                   VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT);
+    return true;
+}
+
+u64 Scene::material_count() const {
+    return material_shadow.elements.length();
+}
+
+u64 Scene::light_count() const {
+    return light_shadow.elements.length();
+}
+
+const GPU_Material& Scene::material(u64 i) const {
+    return material_shadow.elements[i];
+}
+
+const GPU_Delta_Light& Scene::light(u64 i) const {
+    return light_shadow.elements[i];
+}
+
+void Scene::edit_material(u64 i, const GPU_Material& material) {
+    // Image ids index the bindless image and sampler arrays, so edits are clamped to the
+    // entries the set binds.
+    u64 bound_images = Math::min(images.length(), u64{MAX_IMAGES});
+    u64 bound_samplers = Math::min(samplers.length(), u64{MAX_SAMPLERS});
+
+    GPU_Material clamped = material;
+    for(auto& texture : clamped.textures) {
+        if(texture.type != GPU_Texture_ID::image(0, 0).type) continue;
+        if(bound_images == 0 || bound_samplers == 0) {
+            texture = GPU_Texture_ID{};
+            continue;
+        }
+        texture.id = static_cast<u32>(Math::min(u64{texture.id}, bound_images - 1));
+        texture.sampler = static_cast<u32>(Math::min(u64{texture.sampler}, bound_samplers - 1));
+    }
+    material_shadow.edit(i, clamped);
+}
+
+void Scene::edit_light(u64 i, const GPU_Delta_Light& light) {
+    light_shadow.edit(i, light);
+}
+
+Scene::Edits Scene::flush_edits(rvk::Commands& cmds) {
+    Edits edits;
+    edits.materials = material_shadow.flush(cmds, materials);
+    edits.lights = light_shadow.flush(cmds, lights);
+    return edits;
+}
+
+void Scene::keep_textures(Vec<PBRT::Textures::Texture, PBRT::Alloc> textures) {
+    if(!streamed_images.empty()) pbrt_textures = move(textures);
+}
+
+void Scene::keep_textures(Vec<GLTF::Texture, GLTF::Alloc> textures) {
+    if(!streamed_images.empty()) gltf_textures = move(textures);
+}
+
+bool Scene::stream(Async::Pool<>& pool, rvk::Commands& cmds) {
+    if(streamed_images.empty()) return false;
+    if(pbrt_textures.empty() && gltf_textures.empty()) return false;
+
+    u64 feedback_size = MAX_IMAGES * sizeof(u32);
+
+    // The feedback buffers are created by the first frame that renders the scene. Until then it
+    // binds the shared buffer.
+    if(!texture_feedback) {
+        auto feedback = rvk::make_buffer(feedback_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                                                            VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        if(!feedback.ok()) {
+            warn("Failed to allocate texture feedback, images will not stream.");
+            streamed_images.clear();
+            return false;
+        }
+        for(u32 f = 0; f < rvk::frame_count(); f++) {
+            auto readback = rvk::make_staging(feedback_size);
+            if(!readback.ok()) {
+                warn("Failed to allocate texture feedback, images will not stream.");
+                streamed_images.clear();
+                feedback_readback.clear();
+                return false;
+            }
+            u32* requested = reinterpret_cast<u32*>(readback->map());
+            for(u32 i = 0; i < MAX_IMAGES; i++) requested[i] = 0;
+            feedback_readback.push(move(*readback));
+        }
+        texture_feedback = move(*feedback);
+
+        vkCmdFillBuffer(cmds, texture_feedback, 0, feedback_size, 0);
+        memory_barrier(cmds, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                       VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                       VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+        recreate_set();
+    }
+
+    bool changed = false;
+
+    // Finished images replace their smaller versions, which frames in flight may still sample.
+    if(stream_task.ok() && stream_task.done()) {
+        auto uploads = stream_task.block();
+        stream_task = {};
+
+        for(auto& upload : uploads) {
+            auto& streamed = streamed_images[upload.image];
+            if(!upload.gpu.image) {
+                streamed.ceiling = streamed.resident;
+                continue;
+            }
+            rvk::drop([image = move(images[upload.image])]() {});
+            images[upload.image] = move(upload.gpu);
+            streamed.resident = upload.reduction;
+            changed = true;
+        }
+        if(changed) recreate_set();
+    }
+
+    // Each pass uploads at most max_uploads images, those missing the most levels first. An
+    // image is only enlarged as far as the largest extent requested and its planned reduction.
+    if(!stream_task.ok()) {
+        const u32* requested = reinterpret_cast<const u32*>(feedback_readback[rvk::frame()].map());
+
+        Vec<u32, Alloc> targets(streamed_images.length());
+        u32 most = 0;
+        for(u64 i = 0; i < streamed_images.length(); i++) {
+            auto& streamed = streamed_images[i];
+            u32 target = streamed.resident;
+            if(i < MAX_IMAGES) {
+                while(target > streamed.ceiling &&
+                      reduced_extent(streamed.extent, target) < requested[i]) {
+                    target--;
+                }
+            }
+            targets.push(target);
+            most = Math::max(most, streamed.resident - target);
+        }
+
+        Vec<Streamed_Upload, Alloc> requests;
+        for(u32 missing = most; missing > 0 && requests.length() < config.max_uploads;
+            missing--) {
+            for(u64 i = 0; i < streamed_images.length(); i++) {
+                auto& streamed = streamed_images[i];
+                if(streamed.resident - targets[i] != missing) continue;
+                requests.push(Streamed_Upload{
+                    .image = i, .texture = streamed.texture, .reduction = targets[i]});
+                if(requests.length() == config.max_uploads) break;
+            }
+        }
+
+        if(!requests.empty()) {
+            stream_cancel = Box<Stream_Cancel, Alloc>::make();
+            if(!pbrt_textures.empty()) {
+                stream_task = stream_images(pool, config, pbrt_textures.slice(), move(requests),
+                                            *stream_cancel);
+            } else {
+                stream_task = stream_images(pool, config, gltf_textures.slice(), move(requests),
+                                            *stream_cancel);
+            }
+        }
+    }
+
+    // This frame's copy is read back the next time the frame comes around.
+    memory_barrier(cmds, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                   VK_ACCESS_2_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+                   VK_ACCESS_2_TRANSFER_READ_BIT);
+    VkBufferCopy region = {.srcOffset = 0, .dstOffset = 0, .size = feedback_size};
+    vkCmdCopyBuffer(cmds, texture_feedback, feedback_readback[rvk::frame()], 1, &region);
+    memory_barrier(cmds, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+                   VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+                   VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+    return changed;
+}
+
 rvk::Descriptor_Set_Layout& Scene::layout() {
     return descriptor_set_layout;
 }
@@ -2065,20 +4078,61 @@ rvk::Descriptor_Set& Scene::set() {
 
 Scene::Scene() {
     descriptor_set_layout =
-        rvk::make_layout<Layout>(Slice{1u, 1u, 1u, 1u, 1u, MAX_IMAGES, MAX_SAMPLERS});
+        rvk::make_layout<Layout>(Slice{1u, 1u, 1u, 1u, 1u, MAX_IMAGES, MAX_SAMPLERS, 1u});
     recreate_set();
 }
 
-Async::Task<Scene> load(Async::Pool<>& pool, const PBRT::Scene& cpu, u32 parallelism) {
+Scene::~Scene() {
+    // A streaming pass reads the textures of this scene, so it is cancelled and only the uploads
+    // it already started are waited for.
+    if(stream_task.ok()) {
+        {
+            Thread::Lock lock{stream_cancel->mutex};
+            stream_cancel->cancelled = true;
+        }
+        static_cast<void>(stream_task.block());
+    }
+}
+
+Opt<Scene> Progress::take() {
+    Thread::Lock lock{mutex};
+    Opt<Scene> ret = move(latest);
+    latest = {};
+    return ret;
+}
+
+void Progress::publish(Scene&& snapshot) {
+    Thread::Lock lock{mutex};
+    // A snapshot that was never taken was never rendered, so it can be freed immediately.
+    latest = move(snapshot);
+}
+
+Async::Task<Scene> load(Async::Pool<>& pool, const PBRT::Scene& cpu, Config config,
+                        Progress& progress) {
     Scene ret;
-    co_await ret.upload(pool, cpu, parallelism);
+    ret.config = config;
+    ret.progress = &progress;
+    co_await ret.upload(pool, cpu);
     co_return ret;
 }
 
-Async::Task<Scene> load(Async::Pool<>& pool, const GLTF::Scene& cpu, u32 parallelism) {
+Async::Task<Scene> load(Async::Pool<>& pool, const GLTF::Scene& cpu, Config config,
+                        Progress& progress) {
     Scene ret;
-    co_await ret.upload(pool, cpu, parallelism);
+    ret.config = config;
+    ret.progress = &progress;
+    co_await ret.upload(pool, cpu);
     co_return ret;
 }
 
+rvk::Buffer make_shared_feedback() {
+    auto feedback =
+        rvk::make_buffer(MAX_IMAGES * sizeof(u32), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    if(!feedback.ok()) {
+        warn("Failed to allocate shared texture feedback.");
+        return rvk::Buffer{};
+    }
+    return move(*feedback);
+}
+
 } // namespace GPU_Scene
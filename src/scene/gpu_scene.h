@@ -2,6 +2,7 @@
 #pragma once
 
 #include <rpp/base.h>
+#include <rpp/thread.h>
 #include <rvk/rvk.h>
 
 #include "gltf.h"
@@ -11,12 +12,68 @@ using namespace rpp;
 
 namespace GPU_Scene {
 
-struct Scene;
-Async::Task<Scene> load(Async::Pool<>& pool, const PBRT::Scene& cpu, u32 parallelism);
-Async::Task<Scene> load(Async::Pool<>& pool, const GLTF::Scene& cpu, u32 parallelism);
-
 using Alloc = Mallocator<"GPU Scene">;
 
+// Device format of HDR image textures and the environment map, from 16 bytes per texel down to 1.
+enum class HDR_Format : u8 {
+    rgba32f,
+    rgba16f,
+    b10g11r11,
+    e5b9g9r9,
+    bc6h,
+};
+
+struct Config {
+    // Staging ring size, and the device bytes and tasks an upload may have in flight at once.
+    u64 staging_budget = Math::GB(1);
+    u64 device_budget = Math::GB(2);
+    u64 max_uploads = 32;
+
+    // Meshes and objects with a larger device footprint are split into multiple BLASes.
+    u64 max_blas_bytes = Math::MB(512);
+
+    // Images are downsampled, largest first, until they all fit in this many device bytes. An
+    // allocation that fails with the heap otherwise idle also falls back to smaller versions.
+    u64 texture_budget = Math::GB(4);
+    // Block compress 8 bit images as they upload.
+    bool compress_textures = true;
+    // Convert HDR images as they upload. Images the format cannot hold, such as negative values
+    // or alpha in an unsigned format, fall back to a wider one.
+    HDR_Format hdr_format = HDR_Format::rgba16f;
+    // Decoded images are stored here once encoded, for later loads to read instead.
+    const Texture_Cache::Config* texture_cache = null;
+    // Upload only the levels of each image that fit in the tail extent before the scene is
+    // shown. Larger levels stream in afterwards, as far as the texture budget allows, for the
+    // images that renders sample at a finer resolution than is resident.
+    bool stream_textures = false;
+    u32 stream_tail_extent = 64;
+    // Bound as the texture feedback of scenes that don't stream, which the hit shaders still
+    // write. It must outlive every scene loaded with it.
+    rvk::Buffer* shared_feedback = null;
+
+    // Bake objects whose instancing costs more than it saves into the top level BLASes.
+    bool bake_objects = true;
+
+    // Publish snapshots of the finished BLASes while the rest of the scene uploads, at most once
+    // per interval.
+    bool progressive = true;
+    f64 snapshot_interval_ms = 250.0;
+
+    // Derives the upload budget from the core count and the rvk heap sizes.
+    static Config automatic(u64 host_heap, u64 device_heap);
+    // Names the settings above that shape encoded images, for Texture_Cache::Config::settings.
+    u64 texture_cache_settings() const;
+};
+
+struct Scene;
+struct Progress;
+Async::Task<Scene> load(Async::Pool<>& pool, const PBRT::Scene& cpu, Config config,
+                        Progress& progress);
+Async::Task<Scene> load(Async::Pool<>& pool, const GLTF::Scene& cpu, Config config,
+                        Progress& progress);
+// Makes a buffer for Config::shared_feedback, or returns an empty one if it can't be allocated.
+rvk::Buffer make_shared_feedback();
+
 enum class Table_Type : u8 {
     geometry_to_single,
     geometry_to_material,
@@ -72,6 +129,7 @@ struct Geometry_Reference_Flags {
     u32 flip_bt : 1;
     u32 double_sided : 1;
     u32 flip_v : 1;
+    u32 index16 : 1;
 };
 static_assert(sizeof(Geometry_Reference_Flags) == sizeof(u32));
 
@@ -102,6 +160,29 @@ struct GPU_Image {
     rvk::Image_View view;
 };
 
+// An image uploaded at a reduced resolution, which streaming may later replace with a larger one.
+struct Streamed_Image {
+    u64 texture = 0;
+    // Larger extent of the full image, and the reductions planned for the texture budget and
+    // currently uploaded.
+    u32 extent = 0;
+    u32 ceiling = 0;
+    u32 resident = 0;
+};
+
+struct Streamed_Upload {
+    u64 image = 0;
+    u64 texture = 0;
+    u32 reduction = 0;
+    GPU_Image gpu;
+};
+
+// Set when a scene is destroyed during a streaming pass, so the pass starts no more uploads.
+struct Stream_Cancel {
+    Thread::Mutex mutex;
+    bool cancelled = false;
+};
+
 struct GPU_Delta_Light {
     enum class Type : u32 {
         none,
@@ -114,15 +195,32 @@ struct GPU_Delta_Light {
     Vec4 params[2];
 };
 
+// A host visible copy of a device buffer of T, so elements can be edited in place. Edited ranges
+// are copied to the device by the next flush.
+template<typename T>
+struct Shadow {
+    rvk::Buffer buffer;
+    Slice<T> elements;
+    // Element ranges [first, second) edited since the last flush.
+    Vec<Pair<u64, u64>, Alloc> dirty;
+
+    void keep(rvk::Buffer staging, u64 length);
+    void edit(u64 i, const T& value);
+    bool flush(rvk::Commands& cmds, rvk::Buffer& device);
+};
+
 struct Geometry_Result {
     rvk::Buffer geometry;
     Vec<CPU_Geometry_Reference, Alloc> references;
 };
 
+struct Batch_Result;
+struct Upload_Budget;
+
 struct Scene {
 
     Scene();
-    ~Scene() = default;
+    ~Scene();
 
     Scene(Scene& src) = delete;
     Scene& operator=(const Scene& src) = delete;
@@ -137,6 +235,29 @@ struct Scene {
 
     bool has_environment_map() const;
 
+    // Materials and delta lights may be edited while the scene is displayed.
+    u64 material_count() const;
+    u64 light_count() const;
+    const GPU_Material& material(u64 i) const;
+    const GPU_Delta_Light& light(u64 i) const;
+    void edit_material(u64 i, const GPU_Material& material);
+    void edit_light(u64 i, const GPU_Delta_Light& light);
+
+    struct Edits {
+        bool materials = false;
+        bool lights = false;
+    };
+    // Records copies of the pending edits into render queue commands.
+    Edits flush_edits(rvk::Commands& cmds);
+
+    // Streamed scenes upload larger image levels from the textures they were loaded from, so
+    // they take the textures over once the load finishes.
+    void keep_textures(Vec<PBRT::Textures::Texture, PBRT::Alloc> textures);
+    void keep_textures(Vec<GLTF::Texture, GLTF::Alloc> textures);
+    // Swaps in images that finished streaming, starts streaming the images renders asked for,
+    // and records the read back of this frame's requests. Returns whether any image changed.
+    bool stream(Async::Pool<>& pool, rvk::Commands& cmds);
+
     static constexpr u32 SCENE_STAGES =
         VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
         VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR;
@@ -147,7 +268,8 @@ struct Scene {
                         rvk::Bind::Buffer_Storage<SCENE_STAGES>,         // materials
                         rvk::Bind::Image_Sampled<SCENE_STAGES>,          // environment map
                         rvk::Bind::Image_Sampled_Array<SCENE_STAGES>,    // images
-                        rvk::Bind::Sampler_Array<SCENE_STAGES>           // samplers
+                        rvk::Bind::Sampler_Array<SCENE_STAGES>,          // samplers
+                        rvk::Bind::Buffer_Storage<SCENE_STAGES>          // texture feedback
                         >;
 
 private:
@@ -161,10 +283,29 @@ private:
     rvk::TLAS emissive_tlas;
     Vec<rvk::BLAS, Alloc> object_blases;
 
+    // The first top_level_blases entries of object_blases are spatial clusters of the top level
+    // meshes. Clusters starting at top_level_first_emissive only contain emissive meshes.
+    u64 top_level_blases = 0;
+    u64 top_level_first_emissive = 0;
+
+    // Objects too large for one BLAS are split into parts. The BLASes of object i (a PBRT
+    // object or a glTF mesh) are object_blases[object_parts[i], object_parts[i + 1]).
+    Vec<u64, Alloc> object_parts;
+
+    // The hit records of BLAS i start at blas_records[i]. Record r uses the hit group of geometry
+    // record_geometry[r], and BLASes with the same material types share records.
+    Vec<u32, Alloc> blas_records;
+    Vec<u64, Alloc> record_geometry;
+    Map<u64, u32> record_runs;
+    // Whether object i has an emissive mesh, so its instances also go in the emissive TLAS.
+    Vec<bool, Alloc> object_emissive;
+
     // Other Data
 
     rvk::Buffer materials;
     rvk::Buffer lights;
+    Shadow<GPU_Material> material_shadow;
+    Shadow<GPU_Delta_Light> light_shadow;
 
     // Textures
 
@@ -175,6 +316,19 @@ private:
     Vec<rvk::Sampler, Alloc> samplers;
     Map<rvk::Sampler::Config, u64> sampler_configs;
 
+    // Streaming
+
+    // Images uploaded as mip tails, indexed like images, and the textures they are read from.
+    Vec<Streamed_Image, Alloc> streamed_images;
+    Vec<PBRT::Textures::Texture, PBRT::Alloc> pbrt_textures;
+    Vec<GLTF::Texture, GLTF::Alloc> gltf_textures;
+    // Largest extent each image was sampled at, written by the hit shaders and read back through
+    // one staging buffer per frame in flight.
+    rvk::Buffer texture_feedback;
+    Vec<rvk::Buffer, Alloc> feedback_readback;
+    Async::Task<Vec<Streamed_Upload, Alloc>> stream_task;
+    Box<Stream_Cancel, Alloc> stream_cancel;
+
     // Geometry
 
     rvk::Buffer gpu_geometry_references;
@@ -183,10 +337,15 @@ private:
     Vec<u64, Alloc> object_to_geometry_index;
     Vec<CPU_Geometry_Reference, Alloc> cpu_geometry_references;
 
+    // Progressive display
+
+    Progress* progress = null;
+    Profile::Time_Point last_snapshot = {};
+    Async::Task<void> snapshot_task;
+
     /////////////
 
-    Async::Task<void> upload(Async::Pool<>& pool, const PBRT::Scene& cpu, u32 parallelism);
-    Async::Task<void> upload(Async::Pool<>& pool, const GLTF::Scene& cpu, u32 parallelism);
+    Config config;
 
     struct Traversal_Result {
         Vec<rvk::TLAS::Instance, Alloc> instances;
@@ -194,24 +353,69 @@ private:
         Vec<Pair<Mat4, u32>, Alloc> gltf_lights;
     };
 
-    void traverse(Traversal_Result& out, const PBRT::Scene& cpu, const PBRT::Instance& instance,
-                  Mat4 parent_to_world);
-    void traverse(Traversal_Result& out, const GLTF::Scene& cpu, const GLTF::Node& node,
-                  Mat4 parent_to_world);
-
-    Traversal_Result traverse(const PBRT::Scene& cpu);
-    Traversal_Result traverse(const GLTF::Scene& cpu);
+    Async::Task<void> upload(Async::Pool<>& pool, const PBRT::Scene& cpu);
+    Async::Task<void> upload(Async::Pool<>& pool, const GLTF::Scene& cpu);
+
+    // Upload stages, each of which writes a disjoint set of members.
+    Async::Task<void> upload_blases(Async::Pool<>& pool, Upload_Budget& budget,
+                                    const PBRT::Scene& cpu);
+    Async::Task<void> upload_blases(Async::Pool<>& pool, Upload_Budget& budget,
+                                    const GLTF::Scene& cpu);
+    Async::Task<void> upload_textures(Async::Pool<>& pool, Upload_Budget& budget,
+                                      const PBRT::Scene& cpu);
+    Async::Task<void> upload_textures(Async::Pool<>& pool, Upload_Budget& budget,
+                                      const GLTF::Scene& cpu);
+    Async::Task<void> upload_lights(Async::Pool<>& pool, Upload_Budget& budget,
+                                    const PBRT::Scene& cpu);
+    Async::Task<void> upload_lights(Async::Pool<>& pool, const GLTF::Scene& cpu,
+                                    const Traversal_Result& traversal);
+    Async::Task<void> upload_tlases(Async::Pool<>& pool, const Traversal_Result& traversal);
+    Async::Task<void> upload_geometry_references(Async::Pool<>& pool);
+    template<typename CPU_Scene>
+    Async::Task<void> upload_materials(Async::Pool<>& pool, const CPU_Scene& cpu);
+    u32 hit_records(u64 begin, u64 end);
+
+    template<typename CPU_Scene>
+    Async::Task<Traversal_Result> traverse(Async::Pool<>& pool, const CPU_Scene& cpu);
 
     Async::Task<void> await_all(Vec<Async::Task<GPU_Image>, Alloc>& image_tasks);
-    Async::Task<void> await_all(Vec<Async::Task<rvk::BLAS>, Alloc>& blas_tasks,
-                                Vec<Async::Task<Geometry_Result>, Alloc>& geom_tasks);
 
-    friend Async::Task<Scene> load(Async::Pool<>& pool, const PBRT::Scene& cpu, u32 parallelism);
-    friend Async::Task<Scene> load(Async::Pool<>& pool, const GLTF::Scene& cpu, u32 parallelism);
+    template<typename CPU_Scene>
+    Async::Task<void> merge_batches(Async::Pool<>& pool, const CPU_Scene& cpu,
+                                    Vec<Async::Task<Batch_Result>, Alloc>& batches, u64& merged,
+                                    bool wait);
+    template<typename CPU_Scene>
+    void try_snapshot(Async::Pool<>& pool, const CPU_Scene& cpu);
+    template<typename CPU_Scene>
+    Async::Task<void> publish_snapshot(Async::Pool<>& pool, const CPU_Scene& cpu, Scene snapshot);
+
+    friend Async::Task<Scene> load(Async::Pool<>& pool, const PBRT::Scene& cpu, Config config,
+                                   Progress& progress);
+    friend Async::Task<Scene> load(Async::Pool<>& pool, const GLTF::Scene& cpu, Config config,
+                                   Progress& progress);
+};
+
+// Receives renderable snapshots of a scene while it is still uploading. A snapshot borrows the
+// BLASes and geometry of the scene being uploaded, so it must be dropped before that scene is.
+struct Progress {
+
+    // Returns the newest snapshot published since the last call, if any.
+    Opt<Scene> take();
+
+private:
+    void publish(Scene&& snapshot);
+
+    Thread::Mutex mutex;
+    Opt<Scene> latest;
+
+    friend struct Scene;
 };
 
 } // namespace GPU_Scene
 
+RPP_ENUM(GPU_Scene::HDR_Format, rgba32f, RPP_CASE(rgba32f), RPP_CASE(rgba16f), RPP_CASE(b10g11r11),
+         RPP_CASE(e5b9g9r9), RPP_CASE(bc6h));
+
 RPP_ENUM(GPU_Scene::Table_Type, geometry_to_single, RPP_CASE(geometry_to_single),
          RPP_CASE(geometry_to_material), RPP_CASE(geometry_to_id));
 
@@ -84,6 +84,8 @@ struct Parser {
 
     bool world_begun = false;
 
+    const Texture_Cache::Config* texture_cache = null;
+
     Mat4& current_transform() {
         return state_stack.top().transform;
     }
@@ -171,6 +173,7 @@ struct Parser {
         Parser ret(scene_depth + 1);
         ret.directory = directory.clone();
         ret.world_begun = world_begun;
+        ret.texture_cache = texture_cache;
         ret.named_transforms = named_transforms.clone();
         ret.named_objects = named_objects.clone();
         ret.named_materials = named_materials.clone();
@@ -535,6 +538,8 @@ struct Partial_Scene {
     Map<Light_ID, Async::Task<Light>, Alloc> light_tasks;
     Vec<Async::Task<Partial_Scene>, Alloc> import_tasks;
 
+    Vec<String<Alloc>, Alloc> files;
+
     void add_shape(Opt<Object_ID> object_id, Mesh_ID mesh_id) {
         if(object_id.ok())
             objects.get(*object_id).meshes.push(mesh_id);
@@ -715,6 +720,10 @@ struct Partial_Scene {
                 auto id = remap(old_id);
                 lights.insert(id, move(light));
             }
+
+            for(auto& file : import.files) {
+                files.push(move(file));
+            }
         }
     }
 
@@ -890,6 +899,7 @@ struct Partial_Scene {
 
         Scene ret;
         ret.camera = camera;
+        ret.files = move(files);
 
         ret.top_level_meshes = move(top_level_meshes);
         ret.top_level_instances = move(top_level_instances);
@@ -1145,10 +1155,19 @@ static Async::Task<Mesh> load_ply_async(Async::Pool<>& pool, Parser::Graphics st
     co_return mesh;
 }
 
-static Opt<Variant<Image_Data<u8>, Image_Data<f32>>> parse_image_data(String_View filename,
-                                                                      Slice<const u8> file) {
+// Image files decode to 8 bit or float texels, or to the block compressed levels of a KTX2 or DDS
+// container.
+using Decoded_Image = Variant<Image_Data<u8>, Image_Data<f32>, Compressed::Image>;
 
-    if(filename.file_extension() == "pfm"_v) {
+static Opt<Decoded_Image> parse_image_data(String_View filename, Slice<const u8> file) {
+
+    if(Compressed::is_container(file)) {
+
+        auto image = Compressed::load(filename, file);
+        if(!image.ok()) return {};
+        return Opt{Decoded_Image{move(*image)}};
+
+    } else if(filename.file_extension() == "pfm"_v) {
 
         if(file.length() < 7 || !(file[0] == 'P' && (file[1] == 'F' || file[1] == 'f') &&
                                   ascii::is_whitespace(file[2]))) {
@@ -1207,7 +1226,7 @@ static Opt<Variant<Image_Data<u8>, Image_Data<f32>>> parse_image_data(String_Vie
             }
         }
 
-        return Opt{Variant<Image_Data<u8>, Image_Data<f32>>{Image_Data<f32>{
+        return Opt{Decoded_Image{Image_Data<f32>{
             .data = move(data),
             .w = static_cast<u32>(w),
             .h = static_cast<u32>(h),
@@ -1230,7 +1249,7 @@ static Opt<Variant<Image_Data<u8>, Image_Data<f32>>> parse_image_data(String_Vie
         Libc::memcpy(vec.data(), data, vec.length() * sizeof(f32));
         Libc::free(data);
 
-        return Opt{Variant<Image_Data<u8>, Image_Data<f32>>{Image_Data<f32>{
+        return Opt{Decoded_Image{Image_Data<f32>{
             .data = move(vec),
             .w = static_cast<u32>(w),
             .h = static_cast<u32>(h),
@@ -1253,7 +1272,7 @@ static Opt<Variant<Image_Data<u8>, Image_Data<f32>>> parse_image_data(String_Vie
         Libc::memcpy(vec.data(), data, vec.length());
         stbi_image_free(data);
 
-        return Opt{Variant<Image_Data<u8>, Image_Data<f32>>{Image_Data<u8>{
+        return Opt{Decoded_Image{Image_Data<u8>{
             .data = move(vec),
             .w = static_cast<u32>(w),
             .h = static_cast<u32>(h),
@@ -1262,22 +1281,46 @@ static Opt<Variant<Image_Data<u8>, Image_Data<f32>>> parse_image_data(String_Vie
     }
 }
 
-static Async::Task<Light> complete_light_async(Async::Pool<>& pool, String<Alloc> directory,
-                                               String<Alloc> filename, Light light) {
-
 #if LOAD_TEXTURES == 1
+// Images found in the texture cache skip decoding and are read in place from the mapped entry.
+// Otherwise cache_key is set, so the upload stores the image once it is encoded.
+static Async::Task<Opt<Decoded_Image>>
+read_image_async(Async::Pool<>& pool, const String<Alloc>& directory, const String<Alloc>& filename,
+                 const Texture_Cache::Config* texture_cache = null, bool srgb = false,
+                 u64* cache_key = null) {
     auto path = format<Alloc>("%/%\x00"_v, directory, filename);
 
     auto file_ = co_await Async::read(pool, path.view());
-    if(!file_.ok()) co_return light;
+    if(!file_.ok()) co_return Opt<Decoded_Image>{};
     auto file = move(*file_);
 
     co_await pool.suspend();
 
-    if(auto data = parse_image_data(filename.view(), file.slice()); data.ok()) {
+    if(texture_cache && !Compressed::is_container(file.slice())) {
+        u64 entry = Texture_Cache::key(*texture_cache, file.slice(), srgb);
+        if(auto image = Texture_Cache::read(*texture_cache, entry); image.ok()) {
+            co_return Opt{Decoded_Image{move(*image)}};
+        }
+        if(cache_key) *cache_key = entry;
+    }
+
+    co_return parse_image_data(filename.view(), file.slice());
+}
+#endif
+
+static Async::Task<Light> complete_light_async(Async::Pool<>& pool, String<Alloc> directory,
+                                               String<Alloc> filename, Light light) {
+
+#if LOAD_TEXTURES == 1
+    auto data = co_await read_image_async(pool, directory, filename);
+
+    if(data.ok()) {
         move(*data).match(Overload{
             [&](Image_Data<u8>&&) { warn("[PBRT] ignoring non-HDR environment map image."); },
             [&](Image_Data<f32>&& data) { light.map = move(data); },
+            [&](Compressed::Image&&) {
+                warn("[PBRT] ignoring block compressed environment map image.");
+            },
         });
     }
 
@@ -1303,23 +1346,19 @@ static Async::Task<Light> complete_light_async(Async::Pool<>& pool, String<Alloc
 }
 
 static Async::Task<Texture> complete_texture_async(Async::Pool<>& pool, String<Alloc> directory,
-                                                   String<Alloc> filename, Texture texture) {
+                                                   String<Alloc> filename, Texture texture,
+                                                   const Texture_Cache::Config* texture_cache) {
 
 #if LOAD_TEXTURES == 1
-    auto path = format<Alloc>("%/%\x00"_v, directory, filename);
-
     if(texture.type == Textures::Type::ptex) {
         warn("[PBRT] ignoring ptex texture.");
         co_return texture;
     }
 
-    auto file_ = co_await Async::read(pool, path.view());
-    if(!file_.ok()) co_return texture;
-    auto file = move(*file_);
-
-    co_await pool.suspend();
-
-    if(auto data = parse_image_data(filename.view(), file.slice()); data.ok()) {
+    bool srgb = texture.encoding == Textures::Encoding::sRGB;
+    if(auto data = co_await read_image_async(pool, directory, filename, texture_cache,
+                                             srgb, &texture.cache_key);
+       data.ok()) {
         texture.image = move(*data);
     }
 
@@ -1812,6 +1851,7 @@ static Light_ID parse_partial_scene_self_light(Async::Pool<>& pool, Tokenizer& t
 
         scene.lights.insert(id, move(light));
     } else {
+        scene.files.push(parser.directory.append<Alloc>(filename));
         scene.light_tasks.insert(
             id, complete_light_async(pool, parser.directory.clone(), move(filename), move(light)));
     }
@@ -2000,8 +2040,9 @@ static void parse_partial_scene_self_texture(Async::Pool<>& pool, Tokenizer& tok
 
     if(texture.type == Textures::Type::imagemap || texture.type == Textures::Type::ptex) {
 
-        auto task =
-            complete_texture_async(pool, parser.directory.clone(), move(filename), move(texture));
+        scene.files.push(parser.directory.append<Alloc>(filename));
+        auto task = complete_texture_async(pool, parser.directory.clone(), move(filename),
+                                           move(texture), parser.texture_cache);
         scene.texture_tasks.insert(id, move(task));
 
     } else {
@@ -2118,6 +2159,8 @@ static void parse_partial_scene_self_shape(Async::Pool<>& pool, Tokenizer& token
             tokens.fail("Missing required attribute.");
         }
 
+        scene.files.push(parser.directory.append<Alloc>(filename));
+
         auto task = load_ply_async(pool, parser.current_state().clone(), parser.directory.clone(),
                                    filename.string<Alloc>(), material, alpha);
         auto id = scene.next_mesh_id();
@@ -2163,6 +2206,7 @@ static Async::Task<void> parse_partial_scene_include(Async::Pool<>& pool, Partia
     auto& parser = scene.parser;
 
     auto path = parser.directory.append<Alloc>(rel_path);
+    scene.files.push(path.clone());
 
     if(auto file = co_await Async::read(pool, path.view()); file.ok()) {
         tokens.file = move(*file);
@@ -2410,6 +2454,7 @@ static Async::Task<Partial_Scene> parse_partial_scene(Async::Pool<>& pool, Strin
 
     parser.directory = move(directory);
     auto path = parser.directory.append<Alloc>(rel_path);
+    scene.files.push(path.clone());
 
     if(auto file = co_await Async::read(pool, path.view()); file.ok()) {
         tokens.file = move(*file);
@@ -2441,10 +2486,13 @@ static Async::Task<Partial_Scene> parse_partial_scene(Async::Pool<>& pool, Strin
     co_return scene;
 }
 
-Async::Task<Scene> load(Async::Pool<>& pool, String_View path) {
+Async::Task<Scene> load(Async::Pool<>& pool, String_View path,
+                        const Texture_Cache::Config* texture_cache) {
     info("Loading scene from %...", path);
+    Parser parser{0};
+    parser.texture_cache = texture_cache;
     auto scene = co_await parse_partial_scene(pool, path.remove_file_suffix().string<Alloc>(),
-                                              path.file_suffix().string<Alloc>(), Parser{0});
+                                              path.file_suffix().string<Alloc>(), move(parser));
     co_return co_await scene.to_scene();
 }
 
@@ -6,6 +6,9 @@
 #include <rpp/variant.h>
 #include <rpp/vmath.h>
 
+#include "compressed.h"
+#include "texture_cache.h"
+
 using namespace rpp;
 
 namespace PBRT {
@@ -143,7 +146,10 @@ struct Texture {
     Texture_ID tex;
     Texture_ID scale;
 
-    Variant<Image_Data<u8>, Image_Data<f32>> image = Image_Data<u8>{};
+    // KTX2 and DDS files keep their block compressed mip chain, as do texture cache entries.
+    Variant<Image_Data<u8>, Image_Data<f32>, Compressed::Image> image = Image_Data<u8>{};
+    // Texture cache entry the upload writes once the decoded image is encoded, if any.
+    u64 cache_key = 0;
 };
 
 } // namespace Textures
@@ -268,9 +274,13 @@ struct Scene {
     Vec<Material, Alloc> materials;
     Vec<Texture, Alloc> textures;
     Vec<Light, Alloc> lights;
+
+    // Every file the scene was loaded from: the scene file, includes, imports, PLYs, and images.
+    Vec<String<Alloc>, Alloc> files;
 };
 
-Async::Task<Scene> load(Async::Pool<>& pool, String_View file);
+Async::Task<Scene> load(Async::Pool<>& pool, String_View file,
+                        const Texture_Cache::Config* texture_cache = null);
 
 } // namespace PBRT
 
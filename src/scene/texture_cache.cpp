@@ -0,0 +1,50 @@
+
+#include <cstdio>
+#include <rpp/files.h>
+
+#include "../util/hash.h"
+
+#include "texture_cache.h"
+
+namespace Texture_Cache {
+
+// Changes whenever the stored form of an image changes for the same settings.
+static constexpr u64 VERSION = 1;
+
+u64 key(const Config& config, Slice<const u8> file, bool srgb) {
+    u64 h = Digest::bytes(file);
+    h = Digest::combine(h, config.settings);
+    h = Digest::combine(h, VERSION);
+    return Digest::combine(h, srgb);
+}
+
+String<Alloc> path(const Config& config, u64 key) {
+    return format<Alloc>("%/%.ktx2\x00"_v, config.directory, key);
+}
+
+Opt<Compressed::Image> read(const Config& config, u64 key) {
+    auto entry = path(config, key);
+    auto file = Mapped_File::open(entry.view());
+    if(!file.ok()) return {};
+    return Compressed::load(entry.view(), move(*file));
+}
+
+Async::Task<void> write(Async::Pool<>& pool, const Config& config, u64 key,
+                        const Compressed::Image& image) {
+    co_await pool.suspend();
+
+    auto file = Compressed::save_ktx2(image);
+    auto entry = path(config, key);
+    // Named by the image as well, since textures with the same contents share an entry.
+    auto staged = format<Alloc>("%/%.%.tmp\x00"_v, config.directory, key,
+                                reinterpret_cast<u64>(&image));
+
+    // Entries are replaced by renaming, so a reader that has one mapped keeps the old file.
+    if(!Files::write(staged.view(), file.slice()) ||
+       std::rename(reinterpret_cast<const char*>(staged.data()),
+                   reinterpret_cast<const char*>(entry.data())) != 0) {
+        warn("[Texture Cache] failed to write %.", entry);
+    }
+}
+
+} // namespace Texture_Cache
@@ -0,0 +1,37 @@
+
+#pragma once
+
+#include <rpp/base.h>
+#include <rpp/pool.h>
+
+#include "compressed.h"
+
+using namespace rpp;
+
+// Images stored on disk in their final upload form: encoded, with their mip chain, as KTX2 files.
+// Entries are named by a hash of the source file's contents and of the upload settings, so a
+// changed file or setting simply misses and is written again.
+namespace Texture_Cache {
+
+using Alloc = Mallocator<"Texture Cache">;
+
+struct Config {
+    String<Alloc> directory;
+    // Hash of the upload settings that shape the stored images.
+    u64 settings = 0;
+};
+
+// Key of the entry for a source file, whose color space also picks its encoding.
+[[nodiscard]] u64 key(const Config& config, Slice<const u8> file, bool srgb);
+
+// Null terminated path of an entry.
+[[nodiscard]] String<Alloc> path(const Config& config, u64 key);
+
+// Reads an entry in place from its mapped file. Missing or invalid entries return nothing.
+[[nodiscard]] Opt<Compressed::Image> read(const Config& config, u64 key);
+
+// Writes an entry on the pool, warning on failure. The image must outlive the task.
+[[nodiscard]] Async::Task<void> write(Async::Pool<>& pool, const Config& config, u64 key,
+                                      const Compressed::Image& image);
+
+} // namespace Texture_Cache
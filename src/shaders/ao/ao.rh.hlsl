@@ -19,7 +19,7 @@ void main(inout Payload payload, in Attributes attribs) {
     u64 clock = vk::ReadClock(vk::SubgroupScope);
     u32 seed = tea(LaunchID.y * LaunchSize.x + LaunchID.x, u32(clock));
 
-    Hit_Info info = Hit_Info::make(attribs.bary, constants.shading_normals == 1);
+    Hit_Info info = Hit_Info::make(attribs.bary, constants.shading_normals == 1, 0.0f);
 
 	payload.o = info.P + info.offset * info.GN;
     payload.d = sample_hemisphere_cosine_tnb(seed, info.ST, info.SN, info.SB);
@@ -17,6 +17,7 @@ struct Hit_Info {
     f32dir SB;
     f32rgb emission;
     f32v2 uv;
+    f32 lod;
     f32 offset;
     u32 id;
 
@@ -26,12 +27,15 @@ struct Hit_Info {
         ret.N = SN;
         ret.B = SB;
         ret.uv = uv;
+        ret.lod = lod;
         ret.w_o = w_o;
         ret.emission = emission;
         return ret;
     }
 
-    static Hit_Info make(in f32v2 bary, in bool enable_shading_normals) {
+    // cone_width is the width of the incoming ray cone at the hit, or zero to sample textures at
+    // full resolution.
+    static Hit_Info make(in f32v2 bary, in bool enable_shading_normals, in f32 cone_width) {
 
         Hit_Info info;
 
@@ -111,6 +115,19 @@ struct Hit_Info {
             info.uv.y = 1.0f - info.uv.y;
         }
 
+        // Texture LOD
+        // https://www.jcgt.org/published/0010/01/01/
+
+        info.lod = -LARGE_DIST;
+        if(flags.uv && cone_width > 0.0f) {
+            f32v2 uv1 = f32v2(tri.v1.uv) - f32v2(tri.v0.uv);
+            f32v2 uv2 = f32v2(tri.v2.uv) - f32v2(tri.v0.uv);
+            f32 uv_area = abs(uv1.x * uv2.y - uv1.y * uv2.x);
+            f32 world_area = length(cross(mul(edge1, (f32m3x3)o2w), mul(edge2, (f32m3x3)o2w)));
+            f32 cos_theta = abs(dot(info.GN, normalize(g_world_ray_direction)));
+            info.lod = 0.5f * log2(uv_area / world_area) + log2(cone_width) - log2(max(cos_theta, EPSILON));
+        }
+
         // Shading normal
 
         f32dir v0n, v1n, v2n;
@@ -79,9 +79,9 @@ struct GLTF {
     }
 
     static void resolve(inout GPU_Material parameters, in Shade_Info shade) {
-        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, parameters.spectra[0]);
-        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, parameters.spectra[1]);
-        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, parameters.spectra[2]);
+        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, shade.lod, parameters.spectra[0]);
+        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, shade.lod, parameters.spectra[1]);
+        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, shade.lod, parameters.spectra[2]);
     }
 
     static f32rgb emission(in GPU_Material parameters, in Shade_Info shade) {
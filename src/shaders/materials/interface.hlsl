@@ -42,6 +42,7 @@ struct Shade_Info {
     f32rgb emission;
     f32dir w_o;
     f32v2 uv;
+    f32 lod;
 
     f32dir local(in f32dir w) {
         return f32dir(dot(w, T), dot(w, N), dot(w, B));
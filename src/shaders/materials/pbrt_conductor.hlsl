@@ -9,11 +9,11 @@ namespace Material {
 struct PBRT_Conductor {
 
     static void resolve(inout GPU_Material parameters, in Shade_Info shade) {
-        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, parameters.spectra[0]);
-        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, parameters.spectra[1]);
-        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, parameters.spectra[2]);
-        Scene::resolve_texture(parameters.texture_ids[3], shade.uv, parameters.spectra[3]);
-        Scene::resolve_texture(parameters.texture_ids[4], shade.uv, parameters.spectra[4]);
+        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, shade.lod, parameters.spectra[0]);
+        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, shade.lod, parameters.spectra[1]);
+        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, shade.lod, parameters.spectra[2]);
+        Scene::resolve_texture(parameters.texture_ids[3], shade.uv, shade.lod, parameters.spectra[3]);
+        Scene::resolve_texture(parameters.texture_ids[4], shade.uv, shade.lod, parameters.spectra[4]);
         if(parameters.parameters[1] == 0) { // Determine eta, k via reflectance
             f32rgb r = clamp(parameters.spectra[3].rgb, 0.0f, 0.999f);
             parameters.spectra[3].rgb = 1.0f;
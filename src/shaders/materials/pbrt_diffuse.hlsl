@@ -9,7 +9,7 @@ namespace Material {
 struct PBRT_Diffuse {
 
     static void resolve(inout GPU_Material parameters, in Shade_Info shade) {
-        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, parameters.spectra[0]);
+        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, shade.lod, parameters.spectra[0]);
     }
 
     static bool specular(in GPU_Material parameters, in Shade_Info shade, out Delta_Sample delta, inout u32 seed) {
@@ -9,9 +9,9 @@ namespace Material {
 struct PBRT_Diffuse_Transmission {
 
     static void resolve(inout GPU_Material parameters, in Shade_Info shade) {
-        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, parameters.spectra[0]);
-        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, parameters.spectra[1]);
-        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, parameters.spectra[2]);
+        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, shade.lod, parameters.spectra[0]);
+        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, shade.lod, parameters.spectra[1]);
+        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, shade.lod, parameters.spectra[2]);
     }
 
     static bool specular(in GPU_Material parameters, in Shade_Info shade, out Delta_Sample delta, inout u32 seed) {
@@ -13,12 +13,12 @@ namespace Material {
 struct Tungsten_Rough_Plastic {
 
     static void resolve(inout GPU_Material parameters, in Shade_Info shade) {
-        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, parameters.spectra[0]); // Roughness
-        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, parameters.spectra[1]); // Uroughness
-        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, parameters.spectra[2]); // Vroughness
-        Scene::resolve_texture(parameters.texture_ids[3], shade.uv, parameters.spectra[3]); // Medium albedo
-        Scene::resolve_texture(parameters.texture_ids[5], shade.uv, parameters.spectra[5]); // Thickness
-        Scene::resolve_texture(parameters.texture_ids[6], shade.uv, parameters.spectra[6]); // Diffuse albedo
+        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, shade.lod, parameters.spectra[0]); // Roughness
+        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, shade.lod, parameters.spectra[1]); // Uroughness
+        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, shade.lod, parameters.spectra[2]); // Vroughness
+        Scene::resolve_texture(parameters.texture_ids[3], shade.uv, shade.lod, parameters.spectra[3]); // Medium albedo
+        Scene::resolve_texture(parameters.texture_ids[5], shade.uv, shade.lod, parameters.spectra[5]); // Thickness
+        Scene::resolve_texture(parameters.texture_ids[6], shade.uv, shade.lod, parameters.spectra[6]); // Diffuse albedo
         if(parameters.spectra[0].r > 0.0f) {
             parameters.spectra[1].r = parameters.spectra[0].r;
             parameters.spectra[2].r = parameters.spectra[0].r;
@@ -15,13 +15,13 @@ namespace Material {
 struct Tungsten_Smooth_Coat {
 
     static void resolve(inout GPU_Material parameters, in Shade_Info shade) {
-        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, parameters.spectra[0]); // Conductor Roughness
-        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, parameters.spectra[1]); // Conductor Uroughness
-        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, parameters.spectra[2]); // Conductor Vroughness
-        Scene::resolve_texture(parameters.texture_ids[6], shade.uv, parameters.spectra[6]); // Medium Albedo
-        Scene::resolve_texture(parameters.texture_ids[8], shade.uv, parameters.spectra[8]); // Medium thickness
-        Scene::resolve_texture(parameters.texture_ids[9], shade.uv, parameters.spectra[9]); // Conductor eta / Reflectance
-        Scene::resolve_texture(parameters.texture_ids[10], shade.uv, parameters.spectra[10]); // Conductor k
+        Scene::resolve_texture(parameters.texture_ids[0], shade.uv, shade.lod, parameters.spectra[0]); // Conductor Roughness
+        Scene::resolve_texture(parameters.texture_ids[1], shade.uv, shade.lod, parameters.spectra[1]); // Conductor Uroughness
+        Scene::resolve_texture(parameters.texture_ids[2], shade.uv, shade.lod, parameters.spectra[2]); // Conductor Vroughness
+        Scene::resolve_texture(parameters.texture_ids[6], shade.uv, shade.lod, parameters.spectra[6]); // Medium Albedo
+        Scene::resolve_texture(parameters.texture_ids[8], shade.uv, shade.lod, parameters.spectra[8]); // Medium thickness
+        Scene::resolve_texture(parameters.texture_ids[9], shade.uv, shade.lod, parameters.spectra[9]); // Conductor eta / Reflectance
+        Scene::resolve_texture(parameters.texture_ids[10], shade.uv, shade.lod, parameters.spectra[10]); // Conductor k
         if(parameters.parameters[1] == 0) { // Determine eta, k via reflectance
             f32rgb r = clamp(parameters.spectra[9].rgb, 0.0f, 0.999f);
             parameters.spectra[9].rgb = 1.0f;
@@ -19,6 +19,7 @@ struct Payload {
     [[vk::location(0)]] f32point o;
     [[vk::location(1)]] f32dir w_i;
     [[vk::location(2)]] f32rgb throughput;
+    [[vk::location(3)]] f32v2 cone; // Width at the origin and spread angle
 };
 
 [[vk::push_constant]] Constants constants;
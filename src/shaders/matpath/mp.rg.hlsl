@@ -30,10 +30,16 @@ Payload camera_ray(in u32v3 LaunchID, in u32v3 LaunchSize, inout u32 seed) {
     f32v4 target = mul(constants.iP, f32v4(inUV * 2.0 - 1.0, 0, 1));
     f32v4 direction = mul(constants.iV, f32v4(target.xyz, 0));
 
+    // The primary ray cone spreads by the angle between neighboring pixels.
+    f32v2 next_uv = inUV + f32v2(0.0f, 1.0f / LaunchSize.y);
+    f32v4 next_target = mul(constants.iP, f32v4(next_uv * 2.0 - 1.0, 0, 1));
+    f32v4 next_direction = mul(constants.iV, f32v4(next_target.xyz, 0));
+
     Payload payload;
     payload.throughput = 1.0f;
     payload.w_i = normalize(direction.xyz);
     payload.o = mul(constants.iV, f32v4(0, 0, 0, 1)).xyz;
+    payload.cone = f32v2(0.0f, length(normalize(next_direction.xyz) - payload.w_i));
     return payload;
 }
 
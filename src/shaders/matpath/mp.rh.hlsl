@@ -11,6 +11,10 @@
 [[vk::constant_id(0)]]
 const u32 MATERIAL_TYPE = 0;
 
+// Past a scattering bounce the footprint is set by the lobe rather than the pixel, so the cone is
+// widened to at least this spread angle and later hits select coarser levels.
+#define CONE_SCATTER_SPREAD 0.05f
+
 struct Attributes {
     f32v2 bary;
 };
@@ -24,7 +28,10 @@ void main(inout Payload payload, in Attributes attribs) {
     u64 clock = vk::ReadClock(vk::SubgroupScope);
     u32 seed = tea(LaunchID.y * LaunchSize.x + LaunchID.x, u32(clock));
 
-    Hit_Info hit = Hit_Info::make(attribs.bary, constants.shading_normals == 1);
+    f32 cone_width = payload.cone.x + payload.cone.y * RayTCurrent();
+    payload.cone.x = cone_width;
+
+    Hit_Info hit = Hit_Info::make(attribs.bary, constants.shading_normals == 1, cone_width);
 
     GPU_Material material = Scene::get_material(hit.id);
     Shade_Info shade = hit.shade(-payload.w_i);
@@ -52,6 +59,8 @@ void main(inout Payload payload, in Attributes attribs) {
         return;
     }
 
+    payload.cone.y = max(payload.cone.y, CONE_SCATTER_SPREAD);
+
     f32 pdf = Material::pdf(MATERIAL_TYPE, material, shade, payload.w_i, seed);
     if(pdf) {
         f32rgb atten = Material::evaluate(MATERIAL_TYPE, material, shade, payload.w_i, seed);
@@ -11,6 +11,7 @@
 #define GEOM_FLIP_BITANGENT 0x8
 #define GEOM_DOUBLE_SIDED   0x10
 #define GEOM_FLIP_V         0x20
+#define GEOM_INDEX16        0x40
 
 namespace Scene {
 
@@ -33,7 +34,8 @@ struct GPU_Geometry_Flags {
     u32 flip_bt      : 1;
     u32 double_sided : 1;
     u32 flip_v       : 1;
-    u32 pad          : 26;
+    u32 index16      : 1;
+    u32 pad          : 25;
 };
 
 struct Material_Info {
@@ -53,6 +55,10 @@ struct GPU_Geometry {
     f32v4 emission;
 
     u32v3 index(u32 id) {
+        if(flags & GEOM_INDEX16) {
+            uptr addr = indices + id * sizeof(u16v3);
+            return u32v3(vk::RawBufferLoad<u16v3>(addr, 2));
+        }
         uptr addr = indices + id * sizeof(u32v3);
         return vk::RawBufferLoad<u32v3>(addr, 4);
     }
@@ -71,22 +77,50 @@ struct GPU_Geometry {
 [[vk::binding(4, 0)]] Texture2D<float4> Environment_Map;
 [[vk::binding(5, 0)]] Texture2D<float4> Images[];
 [[vk::binding(6, 0)]] SamplerState Samplers[];
+// Largest extent in texels at which each image was magnified, so streamed scenes know which
+// images to upload at a higher resolution.
+[[vk::binding(7, 0)]] RWByteAddressBuffer Texture_Feedback;
 
 f32rgba sample_environment(in f32dir w_i) {
     f32v2 uv = sphere_equal_area(w_i);
     return Environment_Map.SampleLevel(Samplers[0], uv, 0);
 }
 
+void request_extent(in u32 image_id, in f32 extent) {
+    u32 wanted = u32(min(extent, 65536.0f));
+    // Most lookups ask for no more than an earlier one did, so they skip the atomic.
+    if(Texture_Feedback.Load(image_id * 4) < wanted) {
+        Texture_Feedback.InterlockedMax(image_id * 4, wanted);
+    }
+}
+
+// Lookups without a ray cone, such as alpha tests, have no footprint to compare against, so they
+// request the image at its full planned resolution.
 f32rgba sample_image(in u32 image_id, in u32 sampler_id, in f32v2 uv) {
+    request_extent(image_id, 65536.0f);
+    return Images[NonUniformResourceIndex(image_id)].SampleLevel(Samplers[NonUniformResourceIndex(sampler_id)], uv, 0);
+}
+
+// cone_lod is the log2 ratio of a ray cone footprint to the UV extent it covers; scaling it by the
+// image resolution gives how many times the image could be halved before its texels outgrow the
+// footprint. A negative level means the footprint wants more texels than the image has, which
+// streaming reads back. Images have a single level, so the lookup itself always reads level 0.
+f32rgba sample_image_cone(in u32 image_id, in u32 sampler_id, in f32v2 uv, in f32 cone_lod) {
+    u32 w, h;
+    Images[NonUniformResourceIndex(image_id)].GetDimensions(w, h);
+    f32 level = cone_lod + 0.5f * log2(f32(w) * f32(h));
+    if(level < 0.0f) {
+        request_extent(image_id, f32(max(w, h)) * exp2(-level));
+    }
     return Images[NonUniformResourceIndex(image_id)].SampleLevel(Samplers[NonUniformResourceIndex(sampler_id)], uv, 0);
 }
 
-void resolve_texture(in u32 id, in f32v2 uv, out f32rgba color) {
+void resolve_texture(in u32 id, in f32v2 uv, in f32 cone_lod, out f32rgba color) {
     u32 type = (id & TEXTURE_TYPE_MASK) >> TEXTURE_TYPE_SHIFT;
     if(type == TEXTURE_TYPE_IMAGE) {
         u32 image = (id & TEXTURE_IMAGE_MASK) >> TEXTURE_IMAGE_SHIFT;
         u32 sampler_ = (id & TEXTURE_SAMPLER_MASK) >> TEXTURE_SAMPLER_SHIFT;
-        color = sample_image(image, sampler_, uv);
+        color = sample_image_cone(image, sampler_, uv, cone_lod);
     } else if(type == TEXTURE_TYPE_PROC) {
         color = f32rgba(0.5f, 0.0f, 0.5f, 1.0f);
     }
@@ -109,6 +143,7 @@ GPU_Geometry_Flags get_flags(in u32 geometry_id, out Material_Info material) {
     output.flip_bt = (flags & GEOM_FLIP_BITANGENT) == GEOM_FLIP_BITANGENT;
     output.double_sided = (flags & GEOM_DOUBLE_SIDED) == GEOM_DOUBLE_SIDED;
     output.flip_v = (flags & GEOM_FLIP_V) == GEOM_FLIP_V;
+    output.index16 = (flags & GEOM_INDEX16) == GEOM_INDEX16;
     return output;
 }
 
@@ -0,0 +1,54 @@
+
+#include "hash.h"
+
+namespace Digest {
+
+static constexpr u64 PRIME1 = 0x9E3779B185EBCA87ull;
+static constexpr u64 PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr u64 PRIME3 = 0x165667B19E3779F9ull;
+
+static u64 rotl(u64 x, u32 r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static u64 mix_lane(u64 acc, u64 lane) {
+    return rotl(acc + lane * PRIME2, 31) * PRIME1;
+}
+
+static u64 avalanche(u64 h) {
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+u64 bytes(Slice<const u8> data) {
+
+    u64 lanes[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+    u64 n = data.length();
+    const u8* p = data.data();
+
+    u64 i = 0;
+    for(; i + 32 <= n; i += 32) {
+        for(u32 l = 0; l < 4; l++) {
+            u64 lane;
+            Libc::memcpy(&lane, p + i + l * 8, 8);
+            lanes[l] = mix_lane(lanes[l], lane);
+        }
+    }
+
+    u64 h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    h += n;
+    for(; i < n; i++) {
+        h = rotl(h ^ (p[i] * PRIME3), 11) * PRIME1;
+    }
+    return avalanche(h);
+}
+
+u64 combine(u64 h, u64 value) {
+    return avalanche(h ^ mix_lane(PRIME3, value));
+}
+
+} // namespace Digest
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <rpp/base.h>
+
+using namespace rpp;
+
+// 64 bit hashes after xxHash64, for keys that are compared across runs or stored on disk.
+namespace Digest {
+
+// Four independent lanes of xxHash64's round, so the multiplies overlap, then its avalanche.
+// Hashes at memory speed.
+[[nodiscard]] u64 bytes(Slice<const u8> data);
+
+// Mixes value into h.
+[[nodiscard]] u64 combine(u64 h, u64 value);
+
+} // namespace Digest
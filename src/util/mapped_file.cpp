@@ -0,0 +1,85 @@
+#include "mapped_file.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Opt<Mapped_File> Mapped_File::open(String_View path) {
+
+    i32 fd = ::open(reinterpret_cast<const char*>(path.data()), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return {};
+
+    struct stat info = {};
+    if(fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return {};
+    }
+
+    u64 length = static_cast<u64>(info.st_size);
+    void* map = mmap(null, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if(map == MAP_FAILED) return {};
+
+    Mapped_File file;
+    file.map = static_cast<const u8*>(map);
+    file.length = length;
+    return Opt{move(file)};
+}
+
+Mapped_File::~Mapped_File() {
+    if(map) munmap(const_cast<u8*>(map), length);
+}
+
+Mapped_File::Mapped_File(Mapped_File&& src) : map(src.map), length(src.length) {
+    src.map = null;
+    src.length = 0;
+}
+
+Mapped_File& Mapped_File::operator=(Mapped_File&& src) {
+    if(this != &src) {
+        if(map) munmap(const_cast<u8*>(map), length);
+        map = src.map;
+        length = src.length;
+        src.map = null;
+        src.length = 0;
+    }
+    return *this;
+}
+
+#else
+
+Opt<Mapped_File> Mapped_File::open(String_View path) {
+    auto data = Files::read(path);
+    if(!data.ok() || data->empty()) return {};
+
+    Mapped_File file;
+    file.storage = move(*data);
+    file.map = file.storage.data();
+    file.length = file.storage.length();
+    return Opt{move(file)};
+}
+
+Mapped_File::~Mapped_File() {
+}
+
+Mapped_File::Mapped_File(Mapped_File&& src)
+    : map(src.map), length(src.length), storage(move(src.storage)) {
+    src.map = null;
+    src.length = 0;
+}
+
+Mapped_File& Mapped_File::operator=(Mapped_File&& src) {
+    if(this != &src) {
+        storage = move(src.storage);
+        map = src.map;
+        length = src.length;
+        src.map = null;
+        src.length = 0;
+    }
+    return *this;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <rpp/base.h>
+#include <rpp/files.h>
+
+using namespace rpp;
+
+// A whole file, read only. On Linux the file is mapped, so its pages are read as they are first
+// touched; other platforms read it into memory. The bytes stay put when the file is moved.
+struct Mapped_File {
+
+    Mapped_File() = default;
+    ~Mapped_File();
+
+    Mapped_File(const Mapped_File&) = delete;
+    Mapped_File& operator=(const Mapped_File&) = delete;
+    Mapped_File(Mapped_File&& src);
+    Mapped_File& operator=(Mapped_File&& src);
+
+    // The path must be null terminated.
+    [[nodiscard]] static Opt<Mapped_File> open(String_View path);
+
+    [[nodiscard]] Slice<const u8> slice() const {
+        return Slice<const u8>{map, length};
+    }
+    [[nodiscard]] bool empty() const {
+        return length == 0;
+    }
+
+private:
+    const u8* map = null;
+    u64 length = 0;
+#ifndef __linux__
+    Vec<u8, Files::Alloc> storage;
+#endif
+};
@@ -0,0 +1,113 @@
+#include "watch.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+
+File_Watcher::File_Watcher() {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(fd < 0) warn("Failed to initialize inotify, file watching is disabled.");
+}
+
+File_Watcher::~File_Watcher() {
+    if(fd >= 0) close(fd);
+}
+
+void File_Watcher::watch(String_View path) {
+    if(fd < 0) return;
+
+    String_View name = path.file_suffix();
+    String_View directory = path.remove_file_suffix();
+    if(directory.empty()) directory = "."_v;
+
+    i32 wd = -1;
+    Region(R) {
+        auto terminated = format<Mregion<R>>("%\x00"_v, directory);
+        wd = inotify_add_watch(fd, reinterpret_cast<const char*>(terminated.data()),
+                               IN_CLOSE_WRITE | IN_MOVED_TO);
+    }
+    if(wd < 0) {
+        warn("Failed to watch %.", path);
+        return;
+    }
+
+    add(wd, File{name.string<Alloc>(), path.string<Alloc>()});
+}
+
+void File_Watcher::clear() {
+    if(fd < 0) return;
+    for(auto& [wd, _] : directories) {
+        inotify_rm_watch(fd, wd);
+    }
+    directories = {};
+
+    // Drop events queued for the removed watches.
+    static_cast<void>(poll());
+}
+
+Vec<String<File_Watcher::Alloc>, File_Watcher::Alloc> File_Watcher::poll() {
+    Vec<String<Alloc>, Alloc> changed;
+    if(fd < 0) return changed;
+
+    alignas(inotify_event) u8 buffer[4096];
+    while(true) {
+        i64 bytes = static_cast<i64>(read(fd, buffer, sizeof(buffer)));
+        if(bytes <= 0) break;
+
+        for(i64 offset = 0; offset < bytes;) {
+            auto* event = reinterpret_cast<inotify_event*>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            if(event->len == 0) continue;
+
+            auto files = directories.try_get(event->wd);
+            if(!files.ok()) continue;
+
+            String_View name{event->name};
+            for(auto& file : **files) {
+                if(file.name.view() != name) continue;
+
+                bool seen = false;
+                for(auto& path : changed) seen |= path.view() == file.path.view();
+                if(!seen) changed.push(file.path.clone());
+            }
+        }
+    }
+    return changed;
+}
+
+#else
+
+File_Watcher::File_Watcher() {
+}
+
+File_Watcher::~File_Watcher() {
+}
+
+void File_Watcher::watch(String_View path) {
+    if(directories.empty()) warn("File watching is only supported on Linux.");
+    add(-1, File{{}, path.string<Alloc>()});
+}
+
+void File_Watcher::clear() {
+    directories = {};
+}
+
+Vec<String<File_Watcher::Alloc>, File_Watcher::Alloc> File_Watcher::poll() {
+    return {};
+}
+
+#endif
+
+void File_Watcher::add(i32 directory, File file) {
+    if(auto files = directories.try_get(directory); files.ok()) {
+        (*files)->push(move(file));
+    } else {
+        Vec<File, Alloc> added;
+        added.push(move(file));
+        directories.insert(directory, move(added));
+    }
+}
+
+bool File_Watcher::empty() const {
+    return directories.empty();
+}
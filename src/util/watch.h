@@ -0,0 +1,38 @@
+#pragma once
+
+#include <rpp/base.h>
+
+using namespace rpp;
+
+// Reports modifications to a set of files. The directories containing the files are watched
+// rather than the files themselves, since editors often save by replacing the file.
+struct File_Watcher {
+    using Alloc = Mallocator<"File Watcher">;
+
+    File_Watcher();
+    ~File_Watcher();
+
+    File_Watcher(const File_Watcher&) = delete;
+    File_Watcher& operator=(const File_Watcher&) = delete;
+    File_Watcher(File_Watcher&&) = delete;
+    File_Watcher& operator=(File_Watcher&&) = delete;
+
+    void watch(String_View path);
+    void clear();
+    bool empty() const;
+
+    // Returns the watched paths, as passed to watch, modified since the last call.
+    Vec<String<Alloc>, Alloc> poll();
+
+private:
+    struct File {
+        String<Alloc> name;
+        String<Alloc> path;
+    };
+
+    void add(i32 directory, File file);
+
+    i32 fd = -1;
+    // Watched files by the watch descriptor of their directory.
+    Map<i32, Vec<File, Alloc>, Alloc> directories;
+};